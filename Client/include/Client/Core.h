@@ -4,12 +4,23 @@
 
 #include "Client/Camera.h"
 #include "Engine/VertexArray.h"
-#include "Engine/UniformBuffer.h"
 #include "Engine/Texture2D.h"
 
 namespace MalicClient
 {
 
+struct alignas(16) MVP_UBO
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+// Per draw, the model matrix doesn't need a trip through the uniform ring
+struct PushConstants
+{
+    glm::mat4 model;
+};
+
 class ApplicationData
 {
 public:
@@ -22,7 +33,8 @@ public:
 
 public:
     std::vector<Malic::VertexArray> vertexArrays;
-    Malic::UniformBuffer uniformBuffer;
+    MVP_UBO mvp;  // pushed to the uniform ring by the draw that points at it
+    PushConstants pushConstants;  // recorded by the draw that points at it
     Malic::Texture2D texture;
     
     MalicClient::Camera camera;
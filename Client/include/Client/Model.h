@@ -21,14 +21,17 @@ public:
     [[nodiscard]] Malic::RenderResources GetRenderResources() const;
 
 private:
-    void _GetMaterials(const aiScene* scene, const Malic::MalicEngine* engine);
+    void _GetMaterials(const aiScene* scene,
+                       const Malic::MalicEngine* engine,
+                       Malic::UploadBatch& upload_batch);
     void _ProcessNode(const aiNode* node,
                       const aiScene* scene,
                       std::vector<Malic::Vertex>& vertices,
-                      std::vector<uint16_t>& indices) const;
+                      std::vector<uint16_t>& indices);
+    // Every mesh becomes a submesh range of m_renderResources
     void _ProcessMesh(const aiMesh* mesh,
                       std::vector<Malic::Vertex>& vertices,
-                      std::vector<uint16_t>& indices) const;
+                      std::vector<uint16_t>& indices);
 
 private:
     // TODO: Make this an std::array (kinda like RayLib)
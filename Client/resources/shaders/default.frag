@@ -1,14 +1,17 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) out vec4 OutColor;
 
 layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_color;
 layout(location = 2) in vec2 in_uv;
+layout(location = 3) flat in uint in_albedo;
 
-layout(set = 0, binding = 1) uniform sampler2D u_sampler;
+// Every loaded texture, instances drawn together may use different ones
+layout(set = 1, binding = 0) uniform sampler2D u_textures[];
 
 void main()
 {
-    OutColor = vec4(texture(u_sampler, in_uv).rgb, 1.0);
+    OutColor = vec4(texture(u_textures[nonuniformEXT(in_albedo)], in_uv).rgb, 1.0);
 }
\ No newline at end of file
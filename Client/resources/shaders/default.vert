@@ -5,21 +5,31 @@ layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec3 in_color;
 layout(location = 2) in vec2 in_uv;
 
+// Instance Data
+layout(location = 3) in mat4 in_instance_transform;  // locations 3 - 6
+layout(location = 7) in vec4 in_instance_tint;
+layout(location = 8) in uint in_instance_albedo;  // slot in the bindless texture table
+
 // Fragment shader input
 layout(location = 0) out vec3 out_position;
 layout(location = 1) out vec3 out_color;
 layout(location = 2) out vec2 out_uv;
+layout(location = 3) flat out uint out_albedo;
 
 // Uniforms
 layout(set = 0, binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 projection;
 } u_mvp;
 
+layout(push_constant) uniform PushConstants {
+    mat4 model;
+} pc;
+
 void main()
 {
-    gl_Position = u_mvp.projection * u_mvp.view * u_mvp.model * vec4(in_position, 1.0);
-    out_color = in_color;
+    gl_Position = u_mvp.projection * u_mvp.view * pc.model * in_instance_transform * vec4(in_position, 1.0);
+    out_color = in_color * in_instance_tint.rgb;
     out_uv = in_uv;
+    out_albedo = in_instance_albedo;
 }
@@ -16,7 +16,6 @@
 #include "Engine/MalicEntry.h"
 #include "Engine/VertexArray.h"
 #include "Engine/Shader.h"
-#include "Engine/UniformBuffer.h"
 #include "Engine/Material.h"
 
 #include "Client/Input.h"
@@ -25,16 +24,6 @@
 namespace MalicClient
 {
 
-struct alignas(16) MVP_UBO
-{
-    glm::mat4 model;
-    glm::mat4 view;
-    glm::mat4 projection;
-};
-
-struct PushConstants
-{
-};
 static_assert(sizeof(PushConstants) <= Malic::MAX_PUSH_CONSTANTS_SIZE, "PushConstants size larger than 128 bytes.");
 
 Application::Application(Malic::MalicEngine::WindowInfo window_info)
@@ -133,18 +122,14 @@ void MalicEntry(Malic::MalicEngine* engine)
 
     std::vector<Malic::DescriptorInfo> descriptorInfos;
     descriptorInfos.push_back(Malic::DescriptorInfo {
-        .type = Malic::DescriptorTypes::UNIFORM_BUFFER,
+        .type = Malic::DescriptorTypes::UNIFORM_BUFFER_DYNAMIC,
         .stageFlags = Malic::ShaderStages::VERTEX_BIT,
         .binding = 0,
         .count = 1
     });
-    descriptorInfos.push_back(Malic::DescriptorInfo {
-        .type = Malic::DescriptorTypes::COMBINED_IMAGE_SAMPLER,
-        .stageFlags = Malic::ShaderStages::FRAGMENT_BIT,
-        .binding = 1,
-        .count = 1
-    });
+    // Textures come from the engine's bindless table (set 1), picked by the material's albedo
     engine->CreateDescriptors(descriptorInfos);
+    engine->BindUniformRing(0, sizeof(MVP_UBO));
     
     Malic::Material material(defaultShader);
     material.SetAlbedo(resourceManager->GetTexture2D(Malic::File("Client/resources/models/vivian/tex/颜.png")));
@@ -152,18 +137,22 @@ void MalicEntry(Malic::MalicEngine* engine)
     {
         .material = material,
         .vertexInputBindingDescs = myData->vertexArrays.at(0).GetBindingDescriptions(),
-        .vertexInputAttribDescs = myData->vertexArrays.at(0).GetAttribDescriptions()
+        .vertexInputAttribDescs = myData->vertexArrays.at(0).GetAttribDescriptions(),
+        .pushConstantSize = sizeof(PushConstants),
+        .pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT
     };
     engine->AssignPipeline(pipelineConfig);
     engine->AssignRenderList({
         Malic::RenderResources {
             .material = material,
-            .vertexArray = &myData->vertexArrays.at(0)
+            .vertexArray = &myData->vertexArrays.at(0),
+            .uniformData = &myData->mvp,
+            .uniformSize = sizeof(MVP_UBO),
+            .pushConstantData = &myData->pushConstants,
+            .boundingSphere = glm::vec4(0.0f, 0.0f, 0.5f, 0.87f)  // both quads
         }
     });
 
-    myData->uniformBuffer = engine->CreateUBO(0, sizeof(MVP_UBO));
-
     // Model model(engine, "../../Client/resources/models/vivian/vivian.pmx");
 }
 
@@ -176,8 +165,6 @@ void MalicUpdate(Malic::MalicEngine* engine, float delta_time)
 
     MalicClient::ProcessInput(engine, delta_time);
 
-    MVP_UBO mvpUBOData;
-
     glm::mat4 model = glm::mat4(1.0f);
     // model = glm::rotate(model,
     //                     static_cast<float>(glfwGetTime()) * glm::radians(10.0f),
@@ -186,9 +173,8 @@ void MalicUpdate(Malic::MalicEngine* engine, float delta_time)
     glm::mat4 projection =
         myData->camera.GetProjMat(static_cast<float>(windowInfo->width)/static_cast<float>(windowInfo->height));
 
-    mvpUBOData.model = model;
-    mvpUBOData.view = view;
-    mvpUBOData.projection = projection;
-
-    myData->uniformBuffer.UpdateData(&mvpUBOData, sizeof(MVP_UBO));
+    myData->pushConstants.model = model;
+    myData->mvp.view = view;
+    myData->mvp.projection = projection;
+    engine->SetCullingFrustum(projection * view * model);
 }
\ No newline at end of file
@@ -6,7 +6,8 @@ namespace MalicClient
 ApplicationData::ApplicationData(ApplicationData&& other) noexcept
 {
     vertexArrays = std::move(other.vertexArrays);
-    uniformBuffer = std::move(other.uniformBuffer);
+    mvp = other.mvp;
+    pushConstants = other.pushConstants;
     texture = std::move(other.texture);
 
     camera = other.camera;
@@ -16,7 +17,8 @@ ApplicationData::ApplicationData(ApplicationData&& other) noexcept
 ApplicationData& ApplicationData::operator=(ApplicationData&& other) noexcept
 {
     vertexArrays = std::move(other.vertexArrays);
-    uniformBuffer = std::move(other.uniformBuffer);
+    mvp = other.mvp;
+    pushConstants = other.pushConstants;
     texture = std::move(other.texture);
     
     camera = other.camera;
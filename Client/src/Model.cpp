@@ -21,9 +21,12 @@ Model::Model(const Malic::MalicEngine* engine, const char* path)
     std::vector<Malic::Vertex> vertices;
     std::vector<uint16_t> indices;
 
-    _GetMaterials(scene, engine);
+    // Textures and geometry go to the GPU in one submission
+    Malic::UploadBatch uploadBatch;
+    _GetMaterials(scene, engine, uploadBatch);
     _ProcessNode(scene->mRootNode, scene, vertices, indices);
-    m_vertexArray = engine->CreateVertexArray(vertices, indices);
+    m_vertexArray = engine->CreateVertexArray(vertices, indices, &uploadBatch);
+    engine->SubmitUploadBatch(uploadBatch);
     m_renderResources.vertexArray = &m_vertexArray;
     // fmt::print("{}\n", glfwGetTime() - time);
 }
@@ -33,7 +36,9 @@ Model::~Model()
     m_materials.clear();
 }
 
-void Model::_GetMaterials(const aiScene* scene, const Malic::MalicEngine* engine)
+void Model::_GetMaterials(const aiScene* scene,
+                          const Malic::MalicEngine* engine,
+                          Malic::UploadBatch& upload_batch)
 {
     const Malic::ResourceManager* resourceManager = engine->GetResourceManager();
 
@@ -48,7 +53,7 @@ void Model::_GetMaterials(const aiScene* scene, const Malic::MalicEngine* engine
         {
             std::filesystem::path actualPath = "Client/resources/models/vivian";
             actualPath /= path.C_Str();
-            mlcMaterial.SetAlbedo(resourceManager->GetTexture2D(Malic::File(actualPath.string())));
+            mlcMaterial.SetAlbedo(resourceManager->GetTexture2D(Malic::File(actualPath.string()), &upload_batch));
         }
         else
         {
@@ -60,7 +65,7 @@ void Model::_GetMaterials(const aiScene* scene, const Malic::MalicEngine* engine
 void Model::_ProcessNode(const aiNode* node,
                          const aiScene* scene,
                          std::vector<Malic::Vertex>& vertices,
-                         std::vector<uint16_t>& indices) const
+                         std::vector<uint16_t>& indices)
 {
     for (uint32_t i = 0; i < node->mNumMeshes; i++)
     {
@@ -75,8 +80,12 @@ void Model::_ProcessNode(const aiNode* node,
 
 void Model::_ProcessMesh(const aiMesh* mesh,
                          std::vector<Malic::Vertex>& vertices,
-                         std::vector<uint16_t>& indices) const
+                         std::vector<uint16_t>& indices)
 {
+    // Indices are relative to the mesh's own vertices
+    m_renderResources.indexOffset.push_back(static_cast<uint32_t>(indices.size()));
+    m_renderResources.vertexOffset.push_back(static_cast<int32_t>(vertices.size()));
+
     for (uint32_t i = 0; i < mesh->mNumVertices; i++)
     {
         glm::vec3 position(mesh->mVertices[i].x,
@@ -106,6 +115,8 @@ void Model::_ProcessMesh(const aiMesh* mesh,
             indices.push_back(face.mIndices[j]);
         }
     }
+
+    m_renderResources.indexCount.push_back(static_cast<uint32_t>(indices.size()) - m_renderResources.indexOffset.back());
 }
 
 }
\ No newline at end of file
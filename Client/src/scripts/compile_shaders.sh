@@ -5,4 +5,13 @@ then
     mkdir bin
 fi
 glslc default.vert -o bin/default_vert.spv
-glslc default.frag -o bin/default_frag.spv
\ No newline at end of file
+glslc default.frag -o bin/default_frag.spv
+
+# Engine-internal shaders
+cd ../../../Engine/resources/shaders/
+if [[ ! -d "bin" ]]
+then
+    mkdir bin
+fi
+glslc cull.comp -o bin/cull_comp.spv
+glslc hiz.comp -o bin/hiz_comp.spv
\ No newline at end of file
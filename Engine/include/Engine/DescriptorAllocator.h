@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// Hands out descriptor sets from a chain of pools. When the current pool runs
+// out another one is chained on, each new pool twice the size of the last up
+// to DESCRIPTOR_POOL_MAX_SETS. Sets aren't freed one by one, they live as
+// long as the allocator.
+class DescriptorAllocator
+{
+public:
+    DescriptorAllocator() = default;
+    ~DescriptorAllocator() = default;
+    DescriptorAllocator(const DescriptorAllocator&) = delete;
+    DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+    // `sizes_per_set` is what the biggest set allocated from it needs, pools hold that many for every set
+    void Init(VkDevice device, const std::vector<VkDescriptorPoolSize>& sizes_per_set);
+    void ShutDown();
+
+    MLC_NODISCARD VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+
+private:
+    VkDevice m_device = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPoolSize> m_sizesPerSet;
+    uint32_t m_nextPoolSets = 0;
+    VkDescriptorPool m_currentPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool> m_fullPools;
+
+private:
+    MLC_NODISCARD VkDescriptorPool _NextPool();
+};
+
+// Descriptor set layouts keyed by their bindings, asking for the same bindings
+// again returns the same layout. Owns them, they're destroyed with the cache.
+class DescriptorSetLayoutCache
+{
+public:
+    DescriptorSetLayoutCache() = default;
+    ~DescriptorSetLayoutCache() = default;
+    DescriptorSetLayoutCache(const DescriptorSetLayoutCache&) = delete;
+    DescriptorSetLayoutCache& operator=(const DescriptorSetLayoutCache&) = delete;
+
+    void Init(VkDevice device);
+    void ShutDown();
+
+    // `binding_flags` is empty or has one entry per binding
+    MLC_NODISCARD VkDescriptorSetLayout GetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                                  VkDescriptorSetLayoutCreateFlags flags = 0,
+                                                  const std::vector<VkDescriptorBindingFlags>& binding_flags = {});
+
+private:
+    // What the layout was made from, compared when the hash matches
+    struct CachedLayout
+    {
+        VkDescriptorSetLayoutCreateFlags flags;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;  // sorted by binding
+        std::vector<VkDescriptorBindingFlags> bindingFlags;  // in the same order, or empty
+        VkDescriptorSetLayout layout;
+    };
+
+    VkDevice m_device = VK_NULL_HANDLE;
+    std::unordered_multimap<uint64_t, CachedLayout> m_layouts;  // keyed by a hash of the bindings
+};
+
+MLC_NAMESPACE_END
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <mutex>
+#include <functional>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Engine/core/Defines.h"
+#include "Engine/core/FreeListAllocator.h"
+
+MLC_NAMESPACE_START
+
+// Buffers and linear images can't share a page with optimal images
+// (bufferImageGranularity), so they're kept in separate blocks
+enum class DeviceResourceKind
+{
+    LINEAR,
+    OPTIMAL
+};
+
+struct DeviceAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;  // the block, not owned by the resource
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mappedData = nullptr;  // already offset, null if the memory isn't host visible
+    uint32_t memoryTypeIndex = static_cast<uint32_t>(-1);
+    DeviceResourceKind kind = DeviceResourceKind::LINEAR;
+    bool dedicated = false;
+};
+
+struct MemoryHeapStats
+{
+    VkDeviceSize heapSize = 0;
+    VkDeviceSize blockBytes = 0;  // bytes allocated with vkAllocateMemory
+    VkDeviceSize usedBytes = 0;   // bytes handed out to resources
+    uint32_t blockCount = 0;
+    uint32_t allocationCount = 0;
+    // Everything on the device, other processes included. Comes from VK_EXT_memory_budget,
+    // without it budget is a guess and usage only counts our blocks.
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+};
+
+// Called when vkAllocateMemory runs out of memory in a heap. Returns true if it
+// freed something worth retrying for.
+using OutOfDeviceMemoryHandler = std::function<bool(uint32_t heap_index, VkDeviceSize size)>;
+
+// Sub-allocates resources out of big VkDeviceMemory blocks, one set of blocks
+// per memory type and resource kind. Host visible blocks stay mapped for their
+// whole lifetime.
+class DeviceMemoryAllocator
+{
+public:
+    DeviceMemoryAllocator() = default;
+    ~DeviceMemoryAllocator() = default;
+    DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+    DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+    void Init(VkPhysicalDevice physical_device, VkDevice device, bool memory_budget_supported);
+    void ShutDown();
+
+    MLC_NODISCARD DeviceAllocation Allocate(const VkMemoryRequirements& requirements,
+                                            VkMemoryPropertyFlags properties,
+                                            DeviceResourceKind kind);
+    void Free(DeviceAllocation& allocation);
+
+    MLC_NODISCARD uint32_t FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+    MLC_NODISCARD uint32_t GetHeapIndex(uint32_t memory_type_index) const;
+    MLC_NODISCARD std::vector<MemoryHeapStats> GetHeapStats() const;
+    // The handler frees resources, so it's called without the allocator's lock held
+    void SetOutOfMemoryHandler(OutOfDeviceMemoryHandler handler);
+
+private:
+    struct MemoryBlock
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mappedData = nullptr;
+        FreeListAllocator ranges;
+    };
+
+    struct MemoryPool
+    {
+        std::vector<MemoryBlock> blocks;
+    };
+
+    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    VkDevice m_device = VK_NULL_HANDLE;
+    bool m_memoryBudgetSupported = false;
+    OutOfDeviceMemoryHandler m_outOfMemoryHandler;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties {};
+    VkDeviceSize m_nonCoherentAtomSize = 1;
+    std::array<MemoryPool, VK_MAX_MEMORY_TYPES * 2> m_pools;  // [memory type * 2 + kind]
+    std::array<MemoryHeapStats, VK_MAX_MEMORY_HEAPS> m_heapStats;
+    mutable std::mutex m_mutex;
+
+private:
+    MLC_NODISCARD bool _TryAllocate(DeviceAllocation& allocation, VkDeviceSize alignment);
+    MLC_NODISCARD VkDeviceSize _GetBlockSize(uint32_t memory_type_index) const;
+    // VK_NULL_HANDLE if the heap is out of memory
+    MLC_NODISCARD VkDeviceMemory _AllocateMemory(uint32_t memory_type_index, VkDeviceSize size, void** mapped_data);
+    void _FreeMemory(uint32_t memory_type_index, VkDeviceMemory memory, VkDeviceSize size);
+};
+
+MLC_NAMESPACE_END
@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 
 #include "Engine/core/Defines.h"
+#include "Engine/DeviceMemoryAllocator.h"
 
 MLC_NAMESPACE_START
 
@@ -19,10 +20,12 @@ public:
     GPUBuffer& operator=(GPUBuffer&& other) noexcept;
 
     MLC_NODISCARD bool IsUsable() const;
+    MLC_NODISCARD VkDeviceSize GetSize() const;
 
 private:
     VkBuffer m_handle = VK_NULL_HANDLE;
-    VkDeviceMemory m_memory = VK_NULL_HANDLE;
+    DeviceAllocation m_allocation;
+    VkDeviceSize m_size = 0;
     VkMemoryPropertyFlags m_properties = 0;
 };
 
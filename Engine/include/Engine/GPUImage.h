@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 
 #include "Engine/core/Defines.h"
+#include "Engine/DeviceMemoryAllocator.h"
 
 MLC_NAMESPACE_START
 
@@ -19,10 +20,11 @@ public:
     GPUImage& operator=(GPUImage&& other) noexcept;
 
     MLC_NODISCARD bool IsUsable() const;
+    MLC_NODISCARD VkDeviceSize GetSize() const;  // device memory taken up
 
 private:
     VkImage m_handle = VK_NULL_HANDLE;
-    VkDeviceMemory m_memory = VK_NULL_HANDLE;
+    DeviceAllocation m_allocation;
     VkMemoryPropertyFlags m_properties = 0;
 };
 
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// Where a mesh lives in VulkanManager's shared vertex and index buffers, in elements
+struct GeometryRange
+{
+    uint32_t firstVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+};
+
+MLC_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// A pipeline and its layout, made from a PipelineResources by VulkanManager::GetGraphicsPipeline().
+// VulkanManager owns it, pointers stay valid until VulkanManager::DestroyGraphicsPipelines().
+class GraphicsPipeline
+{
+friend class VulkanManager;
+public:
+    GraphicsPipeline() = default;
+    ~GraphicsPipeline() = default;
+    GraphicsPipeline(const GraphicsPipeline&) = delete;
+    GraphicsPipeline& operator=(const GraphicsPipeline&) = delete;
+
+    MLC_NODISCARD bool IsUsable() const;
+    // Compiled in the background, draws using it are skipped or use the fallback until then
+    MLC_NODISCARD bool IsReady() const;
+
+private:
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout m_layout = VK_NULL_HANDLE;
+    uint32_t m_pushConstantSize = 0;
+    VkShaderStageFlags m_pushConstantStages = 0;
+    std::atomic<bool> m_ready = false;  // the rest is only read once this is set
+};
+
+MLC_NAMESPACE_END
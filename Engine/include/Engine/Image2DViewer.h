@@ -19,10 +19,13 @@ public:
     Image2DViewer& operator=(Image2DViewer&& other) noexcept;
 
     bool IsUsable() const;
+    // Slot in VulkanManager's bindless texture table, shaders pick the texture with it
+    MLC_NODISCARD uint32_t GetBindlessIndex() const;
 
 private:
     VkImageView m_imageView = VK_NULL_HANDLE;
     VkSampler m_sampler = VK_NULL_HANDLE;
+    uint32_t m_bindlessIndex = 0;
 };
 
 MLC_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Engine/core/Defines.h"
+#include "Engine/GPUBuffer.h"
+#include "Engine/UploadTicket.h"
+
+MLC_NAMESPACE_START
+
+// Per-instance vertex stream, binding 1 at VK_VERTEX_INPUT_RATE_INSTANCE
+struct InstanceData
+{
+    glm::mat4 transform = glm::mat4(1.0f);
+    glm::vec4 tint = glm::vec4(1.0f);
+    // Into the bindless texture table (Texture2D::GetBindlessIndex()). Render list entries
+    // get their material's albedo. InstanceBuffers keep what they were given, the draw's
+    // material doesn't override it, so set it for every instance or they all sample index 0.
+    uint32_t albedoIndex = 0;
+    uint32_t padding[3] {};  // cull.comp copies it as a std430 struct
+};
+
+class VulkanManager;
+class UploadBatch;
+// Device local instances drawn together with one VertexArray, for sets of
+// instances that don't change every frame. Render list entries without one
+// are merged into instanced draws by VulkanManager instead.
+// Textures come from each instance's albedoIndex, the render list entry's material
+// only keeps its albedo loaded. Textures the instances name have to stay loaded too.
+class InstanceBuffer
+{
+public:
+    InstanceBuffer() = default;
+    InstanceBuffer(const VulkanManager* vulkan_manager,
+                   const std::vector<InstanceData>& instances,
+                   UploadBatch* upload_batch = nullptr);
+    ~InstanceBuffer();
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+    InstanceBuffer(InstanceBuffer&& other) noexcept;
+    InstanceBuffer& operator=(InstanceBuffer&& other) noexcept;
+
+    // Rewrites the instances from `first_instance` on, the buffer doesn't grow.
+    // The upload waits for the frames in flight to finish with the old data,
+    // per-frame changes belong in the render list.
+    void Update(const std::vector<InstanceData>& instances,
+                uint32_t first_instance = 0,
+                UploadBatch* upload_batch = nullptr);
+
+    MLC_NODISCARD const GPUBuffer& GetBuffer() const;
+    MLC_NODISCARD uint32_t GetInstanceCount() const;
+    // Empty if the upload went into a batch, the batch's ticket covers it
+    MLC_NODISCARD UploadTicket GetUploadTicket() const;
+
+private:
+    const VulkanManager* m_vulkanManager = nullptr;
+    GPUBuffer m_buffer;
+    uint32_t m_instanceCount = 0;
+    UploadTicket m_uploadTicket;
+
+private:
+    void _Upload(const std::vector<InstanceData>& instances,
+                 uint32_t first_instance,
+                 UploadBatch* upload_batch,
+                 bool in_use);
+};
+
+MLC_NAMESPACE_END
@@ -9,8 +9,8 @@
 #include "Engine/VulkanManager.h"
 #include "Engine/ResourceManager.h"
 #include "Engine/VertexArray.h"
+#include "Engine/InstanceBuffer.h"
 #include "Engine/DescriptorInfo.h"
-#include "Engine/UniformBuffer.h"
 
 MLC_NAMESPACE_START
 
@@ -37,6 +37,10 @@ public:
     void ShutDown();
 
     MLC_NODISCARD const ResourceManager* GetResourceManager() const;
+    // Per heap, budget and usage include other processes when VK_EXT_memory_budget is there
+    MLC_NODISCARD std::vector<MemoryHeapStats> GetMemoryHeapStats() const;
+    // Indexed by VkSystemAllocationScope
+    MLC_NODISCARD std::array<HostAllocationStats, VulkanHostAllocator::SCOPE_COUNT> GetHostMemoryStats() const;
 
     MLC_NODISCARD bool IsKeyPressed(uint32_t key) const;
     MLC_NODISCARD glm::vec2 GetCursorPos() const;
@@ -47,11 +51,24 @@ public:
     MLC_NODISCARD void* GetUserPointer() const;
 
     MLC_NODISCARD VertexArray CreateVertexArray(const std::vector<Vertex>& vertices,
-                                                const std::vector<uint16_t>& indices) const;
+                                                const std::vector<uint16_t>& indices,
+                                                UploadBatch* upload_batch = nullptr) const;
+    MLC_NODISCARD InstanceBuffer CreateInstanceBuffer(const std::vector<InstanceData>& instances,
+                                                      UploadBatch* upload_batch = nullptr) const;
+    UploadTicket SubmitUploadBatch(UploadBatch& upload_batch) const;
     void CreateDescriptors(const std::vector<DescriptorInfo>& descriptor_infos);
-    MLC_NODISCARD UniformBuffer CreateUBO(uint32_t binding, VkDeviceSize size) const;
+    // `size_per_draw` is the biggest RenderResources::uniformSize that'll be drawn
+    void BindUniformRing(uint32_t binding, VkDeviceSize size_per_draw);
+    // Cached, asking again with the same config returns the same pipeline.
+    // Compiled in the background, see GraphicsPipeline::IsReady().
+    MLC_NODISCARD const GraphicsPipeline* GetPipeline(const PipelineResources& pipeline_config);
+    // Pipeline for render list entries that don't set RenderResources::pipeline
     void AssignPipeline(const PipelineResources& pipeline_config);
+    // Stands in for pipelines that are still compiling, without one their draws are skipped
+    void AssignFallbackPipeline(const PipelineResources& pipeline_config);
     void AssignRenderList(const std::vector<RenderResources>& render_list);
+    // Usually projection * view * model, see VulkanManager::SetCullingFrustum()
+    void SetCullingFrustum(const glm::mat4& clip_from_instance);
 
 private:
     const WindowInfo m_windowInfo;
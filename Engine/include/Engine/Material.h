@@ -27,7 +27,7 @@ public:
 
 private:
     Shader m_shader;
-    const Texture2D* m_albedo;
+    const Texture2D* m_albedo = nullptr;
 };
     
 MLC_NAMESPACE_END
\ No newline at end of file
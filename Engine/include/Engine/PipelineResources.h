@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include "Engine/core/Config.h"
 #include "Engine/core/Defines.h"
 #include "Engine/Material.h"
 
@@ -10,9 +11,19 @@ MLC_NAMESPACE_START
 struct PipelineResources
 {
     Material material;
+    // Only baked in without VK_EXT_vertex_input_dynamic_state's feature, otherwise
+    // every draw uses its VertexArray's descriptions and these are ignored
     std::vector<VkVertexInputBindingDescription> vertexInputBindingDescs;
     std::vector<VkVertexInputAttributeDescription> vertexInputAttribDescs;
-    // alpha blending config
+    // Range of RenderResources::pushConstantData, MAX_PUSH_CONSTANTS_SIZE at most. 0 declares none.
+    uint32_t pushConstantSize = 0;
+    VkShaderStageFlags pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+    bool depthTest = true;
+    bool depthWrite = true;
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+    bool alphaBlending = true;  // source alpha over what's there, off writes the color as is
 };
 
 MLC_NAMESPACE_END
\ No newline at end of file
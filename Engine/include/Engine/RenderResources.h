@@ -4,16 +4,45 @@
 
 #include "Engine/core/Defines.h"
 #include "Engine/Material.h"
+#include "Engine/GraphicsPipeline.h"
+#include "Engine/InstanceBuffer.h"
 
 MLC_NAMESPACE_START
 
 class VertexArray;
 struct RenderResources
 {
+    // The albedo is written into every merged instance. With an instanceBuffer it is NOT
+    // sampled, each instance's InstanceData::albedoIndex is, the albedo is only kept loaded.
     Material material;
+    // From VulkanManager::GetGraphicsPipeline(), nullptr draws with the default one.
+    // Draws are sorted by pipeline, so a few of them in a frame cost a few binds.
+    const GraphicsPipeline* pipeline = nullptr;
     const VertexArray* vertexArray = nullptr;
+    // Copied into the uniform ring every frame, has to stay valid while it is drawn,
+    // the shader sees it through the UNIFORM_BUFFER_DYNAMIC binding
+    const void* uniformData = nullptr;
+    uint32_t uniformSize = 0;
+    // Pushed with vkCmdPushConstants before the draw, the pipeline's PipelineResources::pushConstantSize bytes.
+    // Cheaper than uniform data for small per-object values, but draws with different push
+    // constants can't share an indirect call. Read while the frame is recorded.
+    const void* pushConstantData = nullptr;
+    // 0 (near) to 1 (far), draws sharing a material go front to back
+    float depth = 0.0f;
+    // Drawn once per instance in the buffer, `instance` is ignored then.
+    // Without one, entries sharing vertexArray, pipeline and uniformData are merged
+    // into one instanced draw with each entry's `instance` and albedo.
+    const InstanceBuffer* instanceBuffer = nullptr;
+    InstanceData instance;
+    // Center (xyz) and radius (w) in the vertex array's space, `instance` is culled
+    // with it once VulkanManager has a culling frustum. A radius of 0 is never culled,
+    // neither are instance buffers.
+    glm::vec4 boundingSphere = glm::vec4(0.0f);
+    // Submeshes, relative to the vertex array's first index and vertex.
+    // Empty draws all of it, vertexOffset may stay empty if every submesh starts at 0.
     std::vector<uint32_t> indexOffset;
     std::vector<uint32_t> indexCount;
+    std::vector<int32_t> vertexOffset;
 
 };
 
@@ -15,7 +15,9 @@ class ResourceManager
 friend class MalicEngine;
 public:
     Shader GetShader(const File& vert_file, const File& frag_file) const;
-    const Texture2D* GetTexture2D(const File& file) const;
+    // A texture that's already loaded isn't uploaded again, even with a batch.
+    // The pointer stays valid until shutdown, evicted textures are reloaded in place.
+    const Texture2D* GetTexture2D(const File& file, UploadBatch* upload_batch = nullptr) const;
     
 private:
     ResourceManager() = default;
@@ -28,8 +30,17 @@ private:
     
     std::vector<char> _GetFileBytecode(const File& file) const;
 
+    // Least recently used textures go first, the ones still used by frames in flight stay.
+    // Returns whether anything was evicted.
+    bool _EvictTextures(uint32_t heap_index, VkDeviceSize size);
+    // Called once per frame, evicts from heaps over MEMORY_BUDGET_EVICTION_THRESHOLD
+    void _EnforceMemoryBudget();
+    // Reloads `texture` if it was evicted
+    void _MakeResident(const Texture2D* texture);
+
 private:
     const VulkanManager* m_vulkanManager = nullptr;
+    uint64_t m_evictionReleaseFrame = 0;
 };
 
 MLC_NAMESPACE_END
\ No newline at end of file
@@ -1,31 +1,52 @@
 #pragma once
 
+#include <string>
+
 #include "Engine/core/Defines.h"
 #include "Engine/core/Filesystem.h"
 #include "Engine/GPUImage.h"
 #include "Engine/Image2DViewer.h"
+#include "Engine/UploadTicket.h"
 
 MLC_NAMESPACE_START
 
 class VulkanManager;
+class UploadBatch;
+class ResourceManager;
 class Texture2D
 {
+friend class ResourceManager;
 public:
     Texture2D() = default;
-    Texture2D(const VulkanManager* vulkan_manager, const File& file);
+    Texture2D(const VulkanManager* vulkan_manager, const File& file, UploadBatch* upload_batch = nullptr);
     ~Texture2D();
     Texture2D(const Texture2D&) = delete;
     Texture2D& operator=(const Texture2D&) = delete;
     Texture2D(Texture2D&& other) noexcept;
     Texture2D& operator=(Texture2D&& other) noexcept;
 
+    // False while evicted, ResourceManager loads it again from its file
     MLC_NODISCARD bool IsUsable() const;
-    void Bind() const;
+    // Empty if the upload went into a batch, the batch's ticket covers it
+    MLC_NODISCARD UploadTicket GetUploadTicket() const;
+    MLC_NODISCARD const Image2DViewer& GetViewer() const;
+    // Stays the same while it's loaded, a texture evicted and loaded again may get another one
+    MLC_NODISCARD uint32_t GetBindlessIndex() const;
+    MLC_NODISCARD uint64_t GetLastUsedFrame() const;
+    // Called when a draw is recorded with it, eviction goes least recently used first
+    void MarkUsed(uint64_t frame) const;
 
 private:
     const VulkanManager* m_vulkanManager = nullptr;
+    std::string m_path;
     GPUImage m_image;
     Image2DViewer m_viewer;
+    UploadTicket m_uploadTicket;
+    mutable uint64_t m_lastUsedFrame = 0;
+
+private:
+    void _Load(UploadBatch* upload_batch);
+    void _Unload();
 };
 
-MLC_NAMESPACE_END
\ No newline at end of file
+MLC_NAMESPACE_END
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Engine/core/Defines.h"
+#include "Engine/GPUBuffer.h"
+
+MLC_NAMESPACE_START
+
+// Collects uploads and layout transitions so they go out in one transfer queue
+// submission. Fill it with VulkanManager::Queue*() and hand it to
+// VulkanManager::SubmitUploadBatch(), which records every barrier and copy into
+// a single command buffer. Data is copied into staging memory when it's queued,
+// so the source can be freed right away.
+class UploadBatch
+{
+friend class VulkanManager;
+public:
+    UploadBatch() = default;
+    ~UploadBatch();
+    UploadBatch(const UploadBatch&) = delete;
+    UploadBatch& operator=(const UploadBatch&) = delete;
+
+    MLC_NODISCARD bool IsEmpty() const;
+
+private:
+    struct BufferCopy
+    {
+        VkBuffer src;
+        VkBuffer dst;
+        VkBufferCopy region;
+    };
+
+    struct ImageCopy
+    {
+        VkBuffer src;
+        VkDeviceSize srcOffset;
+        VkImage dst;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    std::vector<VkImageMemoryBarrier> m_preCopyBarriers;   // into TRANSFER_DST
+    std::vector<BufferCopy> m_bufferCopies;
+    std::vector<ImageCopy> m_imageCopies;
+    std::vector<VkImageMemoryBarrier> m_postCopyBarriers;  // out of TRANSFER_DST
+    std::vector<GPUBuffer> m_overflowBuffers;  // staging that didn't fit in the ring
+    bool m_holdsStaging = false;
+    bool m_waitsForFrames = false;  // overwrites something the frames in flight may be reading
+};
+
+MLC_NAMESPACE_END
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// Handed out by async uploads, the upload is done once VulkanManager's upload
+// timeline semaphore reaches value. A default ticket is always complete.
+struct UploadTicket
+{
+    uint64_t value = 0;
+};
+
+MLC_NAMESPACE_END
@@ -4,7 +4,9 @@
 #include <vulkan/vulkan.h>
 
 #include "Engine/core/Defines.h"
-#include "Engine/GPUBuffer.h"
+#include "Engine/GeometryRange.h"
+#include "Engine/UploadBatch.h"
+#include "Engine/UploadTicket.h"
 #include "Engine/VulkanManager.h"
 
 MLC_NAMESPACE_START
@@ -17,13 +19,15 @@ struct Vertex
     glm::vec2 uv;
 };
 
+// A range of VulkanManager's geometry arena, the range is given back on destruction
 class VertexArray
 {
 public:
     VertexArray() = default;
     VertexArray(const VulkanManager* vulkan_manager,
                 const std::vector<Vertex>& vertices,
-                const std::vector<uint16_t>& indices);
+                const std::vector<uint16_t>& indices,
+                UploadBatch* upload_batch = nullptr);
     ~VertexArray();
     VertexArray(const VertexArray&) = delete;
     VertexArray& operator=(const VertexArray&) = delete;
@@ -34,15 +38,15 @@ public:
     MLC_NODISCARD std::vector<VkVertexInputAttributeDescription> GetAttribDescriptions() const;
     MLC_NODISCARD uint32_t GetVerticesCount() const;
     MLC_NODISCARD uint32_t GetIndicesCount() const;
-    MLC_NODISCARD const GPUBuffer& GetVertexBuffer() const;
-    MLC_NODISCARD const GPUBuffer& GetIndexBuffer() const;
+    MLC_NODISCARD uint32_t GetFirstVertex() const;
+    MLC_NODISCARD uint32_t GetFirstIndex() const;
+    // Empty if the upload went into a batch, the batch's ticket covers it
+    MLC_NODISCARD UploadTicket GetUploadTicket() const;
 
 private:
     const VulkanManager* m_vulkanManager = nullptr;
-    uint32_t m_verticesCount = static_cast<uint32_t>(-1);
-    uint32_t m_indicesCount = static_cast<uint32_t>(-1);
-    GPUBuffer m_vertexBuffer;
-    GPUBuffer m_indexBuffer;
+    GeometryRange m_geometry;
+    UploadTicket m_uploadTicket;
 
 private:
     MLC_NODISCARD uint32_t _FindMemoryType(const VkPhysicalDevice& physical_device,
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <mutex>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+struct HostAllocationStats
+{
+    uint64_t currentBytes = 0;       // bytes the driver is holding right now
+    uint64_t peakBytes = 0;
+    uint64_t allocationCount = 0;    // pfnAllocation calls
+    uint64_t reallocationCount = 0;  // pfnReallocation calls
+    uint64_t freeCount = 0;          // pfnFree calls
+    uint64_t internalBytes = 0;      // allocated by the driver itself, reported through notifications
+};
+
+// VkAllocationCallbacks behind MLC_VULKAN_ALLOCATOR. COMMAND scope allocations
+// only live for the duration of a single Vulkan call, so they're bumped out of
+// a linear arena that rewinds once it's empty. Small OBJECT scope allocations
+// come out of fixed-size slot pools. Everything else goes to malloc.
+class VulkanHostAllocator
+{
+public:
+    static constexpr uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+public:
+    ~VulkanHostAllocator();
+    VulkanHostAllocator(const VulkanHostAllocator&) = delete;
+    VulkanHostAllocator& operator=(const VulkanHostAllocator&) = delete;
+
+    MLC_NODISCARD static VulkanHostAllocator& Get();
+
+    MLC_NODISCARD const VkAllocationCallbacks* GetCallbacks() const;
+    // Indexed by VkSystemAllocationScope
+    MLC_NODISCARD std::array<HostAllocationStats, SCOPE_COUNT> GetStats() const;
+    void LogStats() const;
+
+private:
+    enum class BlockSource : uint8_t
+    {
+        HEAP,
+        ARENA,
+        POOL
+    };
+
+    // Sits right in front of every allocation handed to the driver
+    struct BlockHeader
+    {
+        uint64_t size;
+        uint32_t padding;  // from the start of the malloc'd block, heap blocks only
+        BlockSource source;
+        uint8_t scope;
+        uint8_t sizeClass;  // pool blocks only
+        uint8_t reserved;
+    };
+
+    struct SlotPool
+    {
+        std::vector<void*> chunks;
+        void* freeList = nullptr;  // free slots store the next free slot
+    };
+
+    VkAllocationCallbacks m_callbacks {};
+    mutable std::mutex m_mutex;
+    char* m_arena = nullptr;
+    uint64_t m_arenaOffset = 0;
+    uint32_t m_arenaLiveCount = 0;
+    std::vector<SlotPool> m_slotPools;  // slot size is HOST_ALLOCATOR_MIN_SLOT_SIZE << index
+    std::array<HostAllocationStats, SCOPE_COUNT> m_stats;
+
+private:
+    VulkanHostAllocator();
+
+    MLC_NODISCARD void* _Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void _Free(void* memory);
+    MLC_NODISCARD void* _AllocateFromArena(size_t size, size_t alignment);
+    MLC_NODISCARD void* _AllocateFromPool(size_t size, uint8_t& size_class);
+    MLC_NODISCARD void* _AllocateFromHeap(size_t size, size_t alignment, uint32_t& padding);
+
+    static VKAPI_ATTR void* VKAPI_CALL _AllocationCallback(void* user_data,
+                                                           size_t size,
+                                                           size_t alignment,
+                                                           VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL _ReallocationCallback(void* user_data,
+                                                             void* original,
+                                                             size_t size,
+                                                             size_t alignment,
+                                                             VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL _FreeCallback(void* user_data, void* memory);
+    static VKAPI_ATTR void VKAPI_CALL _InternalAllocationCallback(void* user_data,
+                                                                  size_t size,
+                                                                  VkInternalAllocationType type,
+                                                                  VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL _InternalFreeCallback(void* user_data,
+                                                            size_t size,
+                                                            VkInternalAllocationType type,
+                                                            VkSystemAllocationScope scope);
+};
+
+MLC_NAMESPACE_END
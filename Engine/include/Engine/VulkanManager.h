@@ -3,6 +3,8 @@
 #include <array>
 #include <vector>
 #include <optional>
+#include <utility>
+#include <unordered_map>
 // #include <memory>
 
 // TODO: Add Linux
@@ -16,12 +18,26 @@
 
 #include "Engine/core/Config.h"
 #include "Engine/core/Defines.h"
+#include "Engine/core/FreeListAllocator.h"
+#include "Engine/core/RingAllocator.h"
+#include "Engine/core/DeletionQueue.h"
+#include "Engine/core/RadixSort.h"
+#include "Engine/core/FrustumCuller.h"
+#include "Engine/core/ThreadPool.h"
+#include "Engine/core/TaskQueue.h"
+#include "Engine/DeviceMemoryAllocator.h"
+#include "Engine/DescriptorAllocator.h"
+#include "Engine/VulkanHostAllocator.h"
 #include "Engine/GPUBuffer.h"
 #include "Engine/GPUImage.h"
+#include "Engine/GeometryRange.h"
 #include "Engine/Image2DViewer.h"
 #include "Engine/DescriptorInfo.h"
 #include "Engine/PipelineResources.h"
+#include "Engine/GraphicsPipeline.h"
 #include "Engine/RenderResources.h"
+#include "Engine/UploadBatch.h"
+#include "Engine/UploadTicket.h"
 
 MLC_NAMESPACE_START
 
@@ -68,28 +84,65 @@ public:
     void Init(GLFWwindow* window);
     void ShutDown();
 
-    void Present(const RenderResources& render_resources);
+    // Every entry is drawn, sorted so draws sharing state go back to back. Command buffers are
+    // kept and submitted again until the render list or the draw state changes, only
+    // RenderResources::uniformData is read again every frame.
+    void Present(const std::vector<RenderResources>& render_list);
     void WaitIdle();
+    // Stalls until the GPU is idle and destroys everything queued for deletion right away.
+    // Only for when the memory is needed now, e.g. running out of device memory.
+    void FlushDeletionQueue();
     void ResizeFramebuffer();
     MLC_NODISCARD uint32_t GetCurrentFrameInFlight() const;
+    MLC_NODISCARD uint64_t GetFrameCount() const;  // frames presented so far
+    // Budget and usage are only exact with VK_EXT_memory_budget, see MemoryHeapStats
+    MLC_NODISCARD std::vector<MemoryHeapStats> GetMemoryHeapStats() const;
+    MLC_NODISCARD uint32_t GetMemoryHeapIndex(const GPUImage& image) const;
+    // Gets a chance to free memory before an allocation fails
+    void SetOutOfDeviceMemoryHandler(OutOfDeviceMemoryHandler handler);
+    // Takes instances from their own space (after InstanceData::transform) to clip space.
+    // Once set, ring instances are culled against it every frame, see RenderResources::boundingSphere.
+    // That's on the GPU when it's supported, on the CPU before sorting otherwise. The GPU also
+    // culls what's hidden behind the depth of what was drawn.
+    void SetCullingFrustum(const glm::mat4& clip_from_instance);
     
     void AllocateBuffer(GPUBuffer& buffer,
                         VkDeviceSize size,
                         VkBufferUsageFlags usage,
                         VkMemoryPropertyFlags properties) const;
+    // Deallocate*() and Destroy*() don't wait for the GPU, the handles are destroyed
+    // once the frames that could be using them are done
     void DeallocateBuffer(GPUBuffer& buffer) const;
     void UploadBuffer(const GPUBuffer& buffer, const void* data, size_t size) const;
     void CopyBuffer(const GPUBuffer& src, const GPUBuffer& dst, VkDeviceSize size) const;
+    // Copies into the current frame's part of the uniform ring, returns the dynamic offset.
+    // Only valid until the frame is recorded, the ring rewinds whenever the frame is rebuilt.
+    MLC_NODISCARD uint32_t PushUniformData(const void* data, VkDeviceSize size) const;
     MLC_NODISCARD void* GetBufferMapping(const GPUBuffer& buffer,
                                          VkDeviceSize offset,
                                          VkDeviceSize size) const;
+    // Goes through the staging ring on the transfer queue, dst can be device local.
+    // Doesn't block, frames presented afterwards wait for it on the GPU.
+    UploadTicket UploadBufferAsync(const GPUBuffer& dst,
+                                   const void* data,
+                                   VkDeviceSize size,
+                                   VkDeviceSize dst_offset = 0) const;
+
+    // Every VertexArray is a range of two shared buffers, so geometry is bound once per frame
+    MLC_NODISCARD GeometryRange AllocateGeometry(uint32_t vertex_count, uint32_t index_count) const;
+    void DeallocateGeometry(GeometryRange& range) const;
+    void QueueGeometryUpload(UploadBatch& batch,
+                             const GeometryRange& range,
+                             const void* vertices,
+                             const void* indices) const;
 
     void AllocateImage2D(GPUImage& image,
                          int width,
                          int height,
                          VkFormat format,
                          VkImageUsageFlags usage,
-                         VkMemoryPropertyFlags properties) const;
+                         VkMemoryPropertyFlags properties,
+                         uint32_t mip_levels = 1) const;
     void DeallocateImage2D(GPUImage& image) const;
     void TransitionImageLayout(const GPUImage& image,
                                 VkFormat format,
@@ -99,6 +152,41 @@ public:
                            const GPUImage& dst,
                            uint32_t width,
                            uint32_t height) const;
+    // Leaves the image in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    UploadTicket UploadImage2DAsync(const GPUImage& dst,
+                                    const void* pixels,
+                                    VkDeviceSize size,
+                                    uint32_t width,
+                                    uint32_t height) const;
+    // Records into `batch` instead of submitting, see UploadBatch
+    void QueueBufferUpload(UploadBatch& batch,
+                           const GPUBuffer& dst,
+                           const void* data,
+                           VkDeviceSize size,
+                           VkDeviceSize dst_offset = 0) const;
+    // QueueBufferUpload() into a buffer already submitted frames may still read. Submitting
+    // the batch waits for every frame in flight first, so it's for data that rarely changes.
+    void QueueBufferRewrite(UploadBatch& batch,
+                            const GPUBuffer& dst,
+                            const void* data,
+                            VkDeviceSize size,
+                            VkDeviceSize dst_offset = 0) const;
+    void QueueImage2DUpload(UploadBatch& batch,
+                            const GPUImage& dst,
+                            const void* pixels,
+                            VkDeviceSize size,
+                            uint32_t width,
+                            uint32_t height) const;
+    // Only transitions into or out of VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL (or from UNDEFINED)
+    void QueueImageTransition(UploadBatch& batch,
+                              const GPUImage& image,
+                              VkImageLayout old_layout,
+                              VkImageLayout new_layout) const;
+    // One command buffer, one submission. Leaves the batch empty for reuse.
+    UploadTicket SubmitUploadBatch(UploadBatch& batch) const;
+    MLC_NODISCARD bool IsUploadComplete(UploadTicket ticket) const;
+    void WaitUpload(UploadTicket ticket) const;
+    // Also puts it in the bindless texture table, Image2DViewer::GetBindlessIndex() is its slot
     void CreateImage2DViewer(Image2DViewer& viewer, const GPUImage& image, VkFormat format) const;
     void DestroyImage2DViewer(Image2DViewer& viewer) const;
 
@@ -111,13 +199,182 @@ public:
     void CreateDescriptorPool(const std::vector<DescriptorInfo>& descriptor_infos);
     void CreateDescriptorSetLayout(const std::vector<DescriptorInfo>& descriptor_infos);
     void CreateDescriptorSets();
-    void DescriptorSetBindUBO(const std::array<GPUBuffer, MAX_DESCRIPTOR_SETS>& ubo_buffers,
-                              VkDeviceSize offset,
-                              VkDeviceSize size_per_buffer) const;
-    void DescriptorSetBindImage2D(const Image2DViewer& viewer) const;
-    // Create "PipelineSettings" struct and pass everything as an argument
-    void CreateGraphicsPipeline(const PipelineResources& pipeline_config);
-    void DestroyGraphicsPipeline();
+    // Every frame's set sees `range` bytes of that frame's part of the uniform ring,
+    // draws pick their data with a dynamic offset
+    void DescriptorSetBindUniformRing(uint32_t binding, VkDeviceSize range);
+    // Queued for compilation the first time a config is asked for, configs that bake in the same state
+    // share the pipeline. Returns right away, GraphicsPipeline::IsReady() says when it's done.
+    MLC_NODISCARD const GraphicsPipeline* GetGraphicsPipeline(const PipelineResources& pipeline_config);
+    // Blocks until every queued pipeline is compiled
+    void WaitForGraphicsPipelines();
+    // Drawn with by render list entries that don't name a pipeline
+    void SetDefaultGraphicsPipeline(const GraphicsPipeline* pipeline);
+    // Drawn with instead of pipelines that are still compiling, nullptr skips those draws.
+    // It gets their push constants, so its range shouldn't be bigger than theirs.
+    void SetFallbackGraphicsPipeline(const GraphicsPipeline* pipeline);
+    // Every pipeline GetGraphicsPipeline() made, once the frames in flight are done with them
+    void DestroyGraphicsPipelines();
+
+private:
+    struct StagingAllocation
+    {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        void* mappedData;
+    };
+
+    // The parts of a frame the draw batches are recorded in
+    enum class DrawPass : uint32_t
+    {
+        FULL,   // everything at once
+        EARLY,  // occlusion culling's first pass, keeps depth around for the Hi-Z pyramid
+        LATE    // draws on top of the early one
+    };
+
+    // An image the draw passes render into. Render passes only read the format, the
+    // rest is baked into them and the framebuffer. Dynamic rendering reads all of it.
+    struct DrawAttachment
+    {
+        VkImage image;
+        VkImageView view;
+        VkFormat format;
+        VkImageLayout initialLayout;  // before the first pass, UNDEFINED if it isn't loaded
+        VkImageLayout finalLayout;    // after the last pass
+        VkAttachmentLoadOp loadOp;    // of the first pass, the late pass loads what the early one left
+        VkAttachmentStoreOp storeOp;  // of the last pass, the early pass always stores
+        VkClearValue clearValue;
+    };
+
+    // What a frame's draw passes render into
+    struct DrawTarget
+    {
+        DrawAttachment color;
+        DrawAttachment depth;  // and stencil if the format has it, never used
+        VkFramebuffer framebuffer;  // render passes only
+        VkExtent2D extent;
+    };
+
+    // A VertexArray's descriptions in the form vkCmdSetVertexInputEXT takes
+    struct VertexInputLayout
+    {
+        std::vector<VkVertexInputBindingDescription> bindingDescs;  // what it was made from, compared on lookup
+        std::vector<VkVertexInputAttributeDescription> attribDescs;
+        std::vector<VkVertexInputBindingDescription2EXT> bindings;
+        std::vector<VkVertexInputAttributeDescription2EXT> attributes;
+    };
+
+    // Draws that share bindings, recorded as one indirect call
+    struct DrawBatch
+    {
+        const GraphicsPipeline* pipeline;
+        const VertexInputLayout* vertexInput;  // nullptr when it's baked into the pipeline
+        VkDescriptorSet descriptorSet;
+        uint32_t dynamicOffset;
+        VkBuffer instanceBuffer;
+        VkDeviceSize instanceBufferOffset;
+        uint32_t firstCommand;  // in the current frame's part of the indirect ring
+        uint32_t commandCount;
+        const void* pushConstantData;  // from the render list, nullptr pushes nothing
+    };
+
+    // Everything a graphics pipeline bakes in, _CreateGraphicsPipeline() reads nothing else
+    struct GraphicsPipelineKey
+    {
+        VkShaderModule vertShaderModule;
+        VkShaderModule fragShaderModule;
+        std::vector<VkVertexInputBindingDescription> vertexInputBindingDescs;
+        std::vector<VkVertexInputAttributeDescription> vertexInputAttribDescs;  // empty when set per draw
+        uint32_t pushConstantSize;
+        VkShaderStageFlags pushConstantStages;
+        VkCullModeFlags cullMode;
+        VkFrontFace frontFace;
+        bool depthTest;
+        bool depthWrite;
+        VkCompareOp depthCompareOp;
+        bool alphaBlending;
+        VkDescriptorSetLayout descriptorSetLayout;
+        VkDescriptorSetLayout bindlessTextureLayout;
+        VkRenderPass renderPass;  // the early and late occlusion passes are compatible with it, null with dynamic rendering
+        VkFormat colorFormat;     // the attachment formats take the render pass' place with dynamic rendering,
+        VkFormat depthFormat;     // VK_FORMAT_UNDEFINED otherwise
+
+        bool operator==(const GraphicsPipelineKey& other) const;
+    };
+
+    struct GraphicsPipelineKeyHash
+    {
+        size_t operator()(const GraphicsPipelineKey& key) const;
+    };
+
+    // A recording thread's command pool for one frame in flight and swap chain image
+    struct RecordingContext
+    {
+        VkCommandPool commandPool;
+        std::array<VkCommandBuffer, 2> secondaryCmdBuffers;  // a render pass each, occlusion culling draws in two
+    };
+
+    struct RetainedUniform
+    {
+        const void* data;
+        uint32_t size;
+        uint32_t offset;  // in the frame's part of the uniform ring
+    };
+
+    // What a frame in flight's part of the rings was last filled with.
+    // Kept while the draw state hash stays the same, only uniform data is copied again.
+    struct RetainedDraws
+    {
+        uint64_t drawStateHash = 0;
+        uint64_t buildId = 0;  // 0 until built
+        std::vector<DrawBatch> drawBatches;
+        uint32_t drawCommandCount = 0;
+        uint32_t cullObjectCount = 0;
+        VkDeviceSize drawCountsOffset = 0;
+        std::vector<RetainedUniform> uniforms;
+        std::vector<const Texture2D*> textures;  // marked used every frame so they aren't evicted
+    };
+
+    // Command buffers recorded for a frame in flight and swap chain image (which picks the framebuffer)
+    struct RetainedCommands
+    {
+        VkCommandBuffer primaryCmdBuffer;  // from the first recording context's pool
+        std::vector<RecordingContext> recordingContexts;  // a context per recording thread
+        uint64_t buildId = 0;  // the RetainedDraws build it was recorded from
+    };
+
+    // The rest mirror the structs in cull.comp
+    struct CullObject
+    {
+        glm::vec4 sphere;
+        uint32_t command;           // first command of the instance's run
+        uint32_t srcInstance;       // in the instance ring
+        uint32_t dstFirstInstance;  // where the run's visible instances start in m_culledInstanceBuffer
+        uint32_t padding;
+    };
+
+    struct DrawCommandInfo
+    {
+        uint32_t batch;
+        uint32_t batchFirstCommand;
+        uint32_t countCommand;  // the run's first command, which culling wrote the instance count to
+    };
+
+    struct CullParams
+    {
+        glm::vec2 hiZSize;
+        uint32_t hiZLevels;
+        uint32_t objectCount;
+        uint32_t commandCount;
+        uint32_t pass;
+        uint32_t occlusion;
+    };
+
+    struct HiZParams
+    {
+        glm::ivec2 srcSize;
+        glm::ivec2 dstSize;
+        uint32_t fromDepth;
+    };
 
 private:
     VkInstance m_instance = VK_NULL_HANDLE;
@@ -129,6 +386,8 @@ private:
     VkQueue m_graphicsQueue = VK_NULL_HANDLE;  // implicitly destroyed with with VkDevice
     VkQueue m_presentQueue = VK_NULL_HANDLE;
     VkQueue m_transferQueue = VK_NULL_HANDLE;
+    mutable DeviceMemoryAllocator m_memoryAllocator;  // allocations are made from const functions
+    mutable DeletionQueue m_deletionQueue;  // keyed by m_frameCount
 
     VkSwapchainKHR m_swapChain = VK_NULL_HANDLE;
     VkFormat m_swapChainImageFormat;
@@ -136,29 +395,138 @@ private:
     std::vector<VkImage> m_swapChainImages;  // automatically destroyed with the swapchain
     std::vector<VkImageView> m_swapChainImageViews;
 
+    // Passes begin with vkCmdBeginRendering on the swap chain and depth views, there are
+    // no render passes or framebuffers then and the layouts are changed with barriers
+    bool m_dynamicRendering = false;
     VkRenderPass m_renderPass = VK_NULL_HANDLE;
-    VkDescriptorPool m_descriptorPool;
-    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    DescriptorSetLayoutCache m_descriptorSetLayoutCache;
+    DescriptorAllocator m_descriptorAllocator;
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;  // owned by m_descriptorSetLayoutCache
     std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> m_descriptorSets;
-    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
-    VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
+    // A combined image sampler for every Image2DViewer, bound as BINDLESS_TEXTURE_SET. Update after
+    // bind, a new slot is written while frames that don't read it are still in flight.
+    VkDescriptorSetLayout m_bindlessTextureLayout = VK_NULL_HANDLE;  // owned by m_descriptorSetLayoutCache
+    VkDescriptorPool m_bindlessTexturePool = VK_NULL_HANDLE;
+    VkDescriptorSet m_bindlessTextureSet = VK_NULL_HANDLE;
+    uint32_t m_bindlessTextureCapacity = 0;
+    mutable uint32_t m_bindlessTextureCount = 0;  // slots handed out so far
+    mutable std::vector<uint32_t> m_freeBindlessTextures;  // given back once frames using them are done
+    bool m_hasUniformRingBinding = false;
+    uint32_t m_uniformRingBinding = 0;
+    // Map nodes don't move, so RenderResources can point at them
+    std::unordered_map<GraphicsPipelineKey, GraphicsPipeline, GraphicsPipelineKeyHash> m_graphicsPipelines;
+    const GraphicsPipeline* m_defaultPipeline = nullptr;
+    const GraphicsPipeline* m_fallbackPipeline = nullptr;
+    // Set per batch from the vertex array when the device has it, pipelines don't bake it in then
+    bool m_vertexInputDynamicStateSupported = false;
+    PFN_vkCmdSetVertexInputEXT m_vkCmdSetVertexInputEXT = nullptr;
+    mutable std::unordered_multimap<uint64_t, VertexInputLayout> m_vertexInputLayouts;  // keyed by a hash of the descriptions
+    TaskQueue m_pipelineCompileThreads;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;  // loaded at Init, saved at ShutDown
 
     std::vector<VkFramebuffer> m_swapChainFramebuffers;
 
     VkCommandPool m_graphicsCmdPool = VK_NULL_HANDLE;
     VkCommandPool m_transferCmdPool = VK_NULL_HANDLE;
-    std::vector<VkCommandBuffer> m_graphicsCmdBuffers;
     std::vector<VkCommandBuffer> m_transferCmdBuffers;
+    // Large frames are split into chunks of batches recorded into secondary command buffers in parallel
+    mutable ThreadPool m_recordingThreads;
+    // Frames are only rebuilt and re-recorded when what they draw changes
+    std::array<RetainedDraws, MAX_FRAMES_IN_FLIGHT> m_retainedDraws;
+    std::vector<RetainedCommands> m_retainedCommands;  // by frame in flight, then swap chain image
+    uint64_t m_retainedBuildCount = 0;
+    // Bumped by changes recorded frames depend on that aren't in the render list, e.g. the pipeline
+    mutable uint64_t m_drawStateEpoch = 0;
 
     GPUImage m_depthImage;
     VkImageView m_depthImageView = VK_NULL_HANDLE;
 
+    GPUBuffer m_geometryVertexBuffer;
+    GPUBuffer m_geometryIndexBuffer;
+    mutable FreeListAllocator m_geometryVertexRanges;  // in vertices
+    mutable FreeListAllocator m_geometryIndexRanges;   // in indices
+
+    GPUBuffer m_uniformRingBuffer;  // UNIFORM_RING_SIZE_PER_FRAME for every frame in flight
+    VkDeviceSize m_uniformRingAlignment = 1;
+    VkDeviceSize m_uniformRingRange = 0;
+    mutable VkDeviceSize m_uniformRingHead = 0;  // in the current frame's part
+
+    GPUBuffer m_indirectRingBuffer;  // INDIRECT_RING_SIZE_PER_FRAME for every frame in flight
+    mutable VkDeviceSize m_indirectRingHead = 0;  // in the current frame's part
+    bool m_multiDrawIndirectSupported = false;
+    bool m_drawIndirectFirstInstanceSupported = false;
+    bool m_drawIndirectCountSupported = false;
+
+    GPUBuffer m_instanceRingBuffer;  // INSTANCE_RING_SIZE_PER_FRAME for every frame in flight, merged draws' instances
+    mutable uint32_t m_instanceRingHead = 0;  // in instances, in the current frame's part
+
+    // Kept between frames so recording doesn't allocate
+    mutable std::vector<SortItem> m_drawOrder;
+    mutable std::vector<SortItem> m_drawOrderScratch;
+    mutable std::array<std::unordered_map<const void*, uint32_t>, 3> m_drawSortIds;  // pipelines, vertex arrays, albedos
+    mutable std::vector<DrawBatch> m_drawBatches;
+    mutable uint32_t m_drawCommandCount = 0;
+    mutable VkDeviceSize m_drawCountsOffset = 0;  // in the indirect ring, a count per batch when drawing without culling
+    mutable FrustumCuller m_frustumCuller;  // CPU culling, when the GPU can't
+    mutable std::vector<uint8_t> m_drawVisibility;  // by render list index
+
+    // GPU frustum culling, see Engine/resources/shaders/cull.comp. Every buffer has a part per frame in flight.
+    bool m_cullingSupported = false;  // needs drawIndirectCount and the compiled shader
+    bool m_hasCullingFrustum = false;
+    glm::mat4 m_cullingMatrix = glm::mat4(1.0f);
+    std::array<glm::vec4, 6> m_cullingPlanes {};
+    VkDescriptorSetLayout m_cullDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_cullDescriptorPool = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> m_cullDescriptorSets {};
+    VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+    GPUBuffer m_cullObjectBuffer;       // host visible, an object per ring instance
+    GPUBuffer m_drawCommandInfoBuffer;  // host visible, an info per command in the indirect ring
+    GPUBuffer m_culledCommandBuffer;    // laid out like the indirect ring, compacted per batch
+    GPUBuffer m_drawCountBuffer;        // a count per batch
+    GPUBuffer m_culledInstanceBuffer;   // laid out like the instance ring, visible instances only
+    GPUBuffer m_cullFrustumBuffer;      // host visible, the culling matrix, written every frame so retained commands see it
+    mutable uint32_t m_cullObjectCount = 0;
+
+    // Two-phase occlusion culling: draws hidden behind last frame's Hi-Z pyramid are
+    // tested again against one built from this frame's first draws, then drawn in a second pass
+    bool m_depthSampled = false;  // the depth format supports VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+    bool m_occlusionCullingSupported = false;  // needs drawIndirectFirstInstance, a sampled depth format and hiz.comp
+    VkRenderPass m_earlyRenderPass = VK_NULL_HANDLE;  // leaves the attachments for the late one
+    VkRenderPass m_lateRenderPass = VK_NULL_HANDLE;
+    GPUBuffer m_lateObjectBuffer;           // a count, then cull objects that failed against last frame's pyramid
+    GPUBuffer m_lateInstanceCountBuffer;    // a count per command
+    GPUBuffer m_lateCulledCommandBuffer;    // laid out like the indirect ring
+    GPUBuffer m_lateDrawCountBuffer;        // a count per batch
+    GPUImage m_hiZImage;  // R32_SFLOAT, the farthest depth per texel, always in VK_IMAGE_LAYOUT_GENERAL
+    VkImageView m_hiZView = VK_NULL_HANDLE;  // every level
+    std::vector<VkImageView> m_hiZLevelViews;
+    VkExtent2D m_hiZExtent {};
+    VkSampler m_hiZSampler = VK_NULL_HANDLE;  // nearest, for the pyramid and the depth attachment
+    VkDescriptorSetLayout m_hiZDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_hiZDescriptorPool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_hiZDescriptorSets;  // a set per level
+    VkPipelineLayout m_hiZPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_hiZPipeline = VK_NULL_HANDLE;
+    mutable bool m_hiZValid = false;  // the pyramid holds a previous frame's depth
+
+    GPUBuffer m_stagingBuffer;
+    mutable RingAllocator m_stagingRing;
+    mutable std::vector<std::pair<uint64_t, GPUBuffer>> m_stagingOverflowBuffers;  // uploads too big for the ring
+
+    // Every transfer queue submission signals the next value
+    VkSemaphore m_uploadTimeline = VK_NULL_HANDLE;
+    mutable uint64_t m_uploadTimelineValue = 0;  // last submitted
+    mutable std::vector<std::pair<uint64_t, VkCommandBuffer>> m_pendingUploadCmdBuffers;
+    mutable uint32_t m_openUploadBatches = 0;  // batches holding staging memory that isn't submitted yet
+
     std::vector<VkSemaphore> m_imageAvailableSemaphores;
     std::vector<VkSemaphore> m_renderFinishedSemaphores;
     std::vector<VkFence> m_inFlightFences;
 
-    PipelineResources m_pipelineConfig;
     uint32_t m_currentFrameIndex = 0;  // 0 -> MAX_FRAMES_IN_FLIGHT - 1
+    uint64_t m_frameCount = 0;
+    bool m_memoryBudgetSupported = false;
     bool m_framebufferResized = false;
     GLFWwindow* m_window = nullptr;
 
@@ -189,6 +557,8 @@ private:
     void _PickPhysicalDevice();
     
     void _CreateLogicalDevice();
+    void _CreatePipelineCache();
+    void _SavePipelineCache() const;
 
     void _GetQueues();
     
@@ -204,9 +574,22 @@ private:
 
     void _CreateCommandPools();
     void _CreateCommandBuffers();
-    void _RecordCommandBuffer(VkCommandBuffer command_buffer,
-                              uint32_t swch_image_index,
-                              const RenderResources& render_resources) const;
+    // Everything recorded frames depend on, render list contents included
+    MLC_NODISCARD GraphicsPipelineKey _GetGraphicsPipelineKey(const PipelineResources& pipeline_config) const;
+    void _CreateGraphicsPipeline(const GraphicsPipelineKey& key, GraphicsPipeline& pipeline) const;
+    MLC_NODISCARD const GraphicsPipeline* _GetDrawPipeline(const RenderResources& draw) const;
+    MLC_NODISCARD const VertexInputLayout* _GetVertexInputLayout(const VertexArray* vertex_array) const;
+    MLC_NODISCARD uint64_t _HashDrawState(const std::vector<RenderResources>& render_list) const;
+    // Sorts and batches the render list into the current frame's part of the rings
+    void _BuildRetainedDraws(const std::vector<RenderResources>& render_list);
+    // Brings the current frame's built draws back for recording and refreshes their uniform data
+    void _ReuseRetainedDraws();
+    void _RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t swch_image_index) const;
+    // Fills m_drawOrder with render_list indices sorted by pipeline, vertex array, material, depth.
+    // With `cpu_culling`, entries outside the culling frustum are left out.
+    void _SortDraws(const std::vector<RenderResources>& render_list, bool cpu_culling) const;
+    void _WriteUniformRingDescriptor(VkDescriptorSet descriptor_set, uint32_t frame_index) const;
+    void _WriteBindlessTexture(uint32_t index, const Image2DViewer& viewer) const;
 
     MLC_NODISCARD VkFormat _FindSupportedFormat(const std::vector<VkFormat>& candidates,
                                                 VkImageTiling tiling,
@@ -217,7 +600,79 @@ private:
 
     void _CreateSyncObjects();
 
+    void _CreateStagingBuffer();
+    void _DestroyStagingBuffer();
+    void _CreateUploadTimeline();
+    void _CreateGeometryArena();
+    void _DestroyGeometryArena();
+    void _CreateUniformRing();
+    void _DestroyUniformRing();
+    void _CreateInstanceRing();
+    void _DestroyInstanceRing();
+    // Space for `count` instances in the current frame's part of the instance ring
+    MLC_NODISCARD InstanceData* _AllocateInstances(uint32_t count, uint32_t& first_instance) const;
+    void _CreateIndirectRing();
+    void _DestroyIndirectRing();
+    // `offset` is from the start of the buffer, everything in it is 4 byte aligned
+    MLC_NODISCARD void* _AllocateIndirectData(VkDeviceSize size, VkDeviceSize& offset) const;
+    void _CreateBindlessTextures();
+    void _DestroyBindlessTextures();
+    // Turns the sorted render list into m_drawBatches, filling the instance and indirect rings.
+    // The uniform data and textures it used are noted in `retained_draws`.
+    void _BuildDrawBatches(const std::vector<RenderResources>& render_list,
+                           bool culling,
+                           RetainedDraws& retained_draws) const;
+    // Depend on the swap chain image count, recreated with it
+    void _CreateRetainedCommands();
+    void _DestroyRetainedCommands();
+    // Begins `pass` and draws every batch. Without culled buffers the commands come straight from the indirect ring.
+    // Big enough frames are split across the recording threads.
+    void _RecordDrawBatches(VkCommandBuffer command_buffer,
+                            DrawPass pass,
+                            const DrawTarget& target,
+                            uint32_t swch_image_index,
+                            const GPUBuffer* culled_commands,
+                            const GPUBuffer* draw_counts) const;
+    // The swap chain image and the depth image, cleared and presented
+    MLC_NODISCARD DrawTarget _GetSwapChainDrawTarget(uint32_t swch_image_index) const;
+    // vkCmdBeginRenderPass, or with dynamic rendering the barriers and vkCmdBeginRendering that do the same
+    void _BeginDrawPass(VkCommandBuffer command_buffer, DrawPass pass, const DrawTarget& target, bool secondary_contents) const;
+    void _EndDrawPass(VkCommandBuffer command_buffer, DrawPass pass, const DrawTarget& target) const;
+    MLC_NODISCARD VkRenderPass _GetDrawPassRenderPass(DrawPass pass) const;
+    // Binds everything the batches in [first_batch, end_batch) need and draws them, inside a render pass.
+    // Only reads recording state, so it's safe to call from several threads at once.
+    void _RecordDrawBatchRange(VkCommandBuffer command_buffer,
+                               const VkExtent2D& extent,
+                               uint32_t first_batch,
+                               uint32_t end_batch,
+                               const GPUBuffer* culled_commands,
+                               const GPUBuffer* draw_counts) const;
+    void _DrawIndirectBatch(VkCommandBuffer command_buffer,
+                            uint32_t batch_index,
+                            const GPUBuffer* culled_commands,
+                            const GPUBuffer* draw_counts) const;
+    void _CreateCulling();
+    void _DestroyCulling();
+    MLC_NODISCARD VkPipeline _CreateComputePipeline(VkPipelineLayout pipeline_layout, const std::vector<char>& bytecode) const;
+    void _CreateHiZPipeline();
+    // Depends on the swap chain extent, recreated with it
+    void _CreateHiZResources();
+    void _DestroyHiZResources();
+    MLC_NODISCARD bool _IsCullingActive() const;
+    MLC_NODISCARD bool _IsOcclusionCullingActive() const;
+    // Culls and compacts this frame's batches, has to be outside the render pass
+    void _RecordCulling(VkCommandBuffer command_buffer, bool occlusion) const;
+    // Rebuilds the pyramid from the depth attachment and culls the late list against it
+    void _RecordLateCulling(VkCommandBuffer command_buffer) const;
+    void _DispatchCullPass(VkCommandBuffer command_buffer, CullParams& params, uint32_t pass, uint32_t thread_count) const;
+
     // ----- Commands -----
+    void _RecordCopyBufferToImage(VkCommandBuffer command_buffer,
+                                  VkBuffer src,
+                                  VkDeviceSize src_offset,
+                                  VkImage dst,
+                                  uint32_t width,
+                                  uint32_t height) const;
 
     // ----- Utility Functions -----
 
@@ -225,8 +680,12 @@ private:
     void _RecreateSwapChain();
     MLC_NODISCARD VkImageView _CreateImageView(const VkImage& image,
                                                VkFormat format,
-                                               VkImageAspectFlags aspectFlags) const;
-    MLC_NODISCARD uint32_t _FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+                                               VkImageAspectFlags aspectFlags,
+                                               uint32_t base_mip_level = 0,
+                                               uint32_t mip_level_count = 1) const;
+    MLC_NODISCARD StagingAllocation _AllocateStaging(UploadBatch& batch, VkDeviceSize size) const;
+    void _ReclaimUploads() const;
+    MLC_NODISCARD UploadTicket _SubmitUpload(VkCommandBuffer command_buffer) const;
     MLC_NODISCARD VkCommandBuffer _BeginSingleUseCommands(const VkCommandPool& command_pool) const;
     void _EndSingleUseCommands(VkCommandBuffer& command_buffer, const VkCommandPool& command_pool) const;
 };
@@ -23,16 +23,62 @@ const std::array DEVICE_EXTENSIONS {
     // VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME
 };
 
+// Enabled when the device has them
+const std::array OPTIONAL_DEVICE_EXTENSIONS {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+};
+
 const size_t MAX_PUSH_CONSTANTS_SIZE = 128;
 
 const uint32_t VERTEX_ATTRIB_INDEX_POSITION = 0;
 const uint32_t VERTEX_ATTRIB_INDEX_COLOR = 1;
 const uint32_t VERTEX_ATTRIB_INDEX_UV = 2;
+const uint32_t VERTEX_ATTRIB_INDEX_INSTANCE_TRANSFORM = 3;  // a mat4 takes 4 locations
+const uint32_t VERTEX_ATTRIB_INDEX_INSTANCE_TINT = 7;
+const uint32_t VERTEX_ATTRIB_INDEX_INSTANCE_ALBEDO = 8;
+const uint32_t VERTEX_BINDING_INDEX_VERTEX = 0;
+const uint32_t VERTEX_BINDING_INDEX_INSTANCE = 1;
 
 const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
 const uint32_t MAX_DESCRIPTOR_SETS = MAX_FRAMES_IN_FLIGHT;
-const uint32_t MAX_DESCRIPTOR_PER_SET_UNIFORM_BUFFER = 1;
-const uint32_t MAX_DESCRIPTOR_PER_SET_COMBINED_SAMPLER = 1;
+// DescriptorAllocator pools start at this many sets and double each time one fills up
+const uint32_t DESCRIPTOR_POOL_INITIAL_SETS = 64;
+const uint32_t DESCRIPTOR_POOL_MAX_SETS = 4096;
+// Set 1 of every graphics pipeline layout, an array of every loaded texture
+const uint32_t BINDLESS_TEXTURE_SET = 1;
+const uint32_t MAX_BINDLESS_TEXTURES = 4096;  // lowered to what the device allows
+
+const VkDeviceSize DEVICE_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+const VkDeviceSize DEVICE_MEMORY_SMALL_HEAP_SIZE = 1024 * 1024 * 1024;  // heaps this small get heapSize / 8 blocks
+// ResourceManager starts evicting textures past the threshold and stops at the target (fractions of the heap budget)
+const float MEMORY_BUDGET_EVICTION_THRESHOLD = 0.9f;
+const float MEMORY_BUDGET_EVICTION_TARGET = 0.8f;
+const VkDeviceSize STAGING_BUFFER_SIZE = 32 * 1024 * 1024;
+const VkDeviceSize STAGING_BUFFER_ALIGNMENT = 16;  // covers texel size alignment of buffer -> image copies
+
+const VkDeviceSize UNIFORM_RING_SIZE_PER_FRAME = 16 * 1024 * 1024;  // 64K draws at 256 byte alignment
+const VkDeviceSize INSTANCE_RING_SIZE_PER_FRAME = 8 * 1024 * 1024;  // ~100K merged instances
+const VkDeviceSize INDIRECT_RING_SIZE_PER_FRAME = 2 * 1024 * 1024;  // ~100K VkDrawIndexedIndirectCommands
+const uint32_t MAX_DRAW_BATCHES_PER_FRAME = 4096;  // indirect calls in one frame with GPU culling
+const uint32_t CULL_WORKGROUP_SIZE = 64;  // local_size_x in cull.comp
+const uint32_t HIZ_WORKGROUP_SIZE = 8;  // local_size_x and local_size_y in hiz.comp
+const uint32_t MAX_HIZ_LEVELS = 16;  // enough for a 32K framebuffer
+const uint32_t MAX_RECORDING_THREADS = 8;  // including the main thread
+const uint32_t MIN_DRAW_BATCHES_PER_RECORDING_THREAD = 64;  // scenes with fewer batches are recorded inline
+const uint32_t PIPELINE_COMPILE_THREADS = 2;
+const bool USE_DYNAMIC_RENDERING = true;  // when the device has it, render passes and framebuffers otherwise
+
+const uint32_t GEOMETRY_ARENA_VERTEX_CAPACITY = 1 << 20;
+const uint32_t GEOMETRY_ARENA_INDEX_CAPACITY = 1 << 22;
+
+const size_t HOST_ALLOCATOR_ARENA_SIZE = 1024 * 1024;  // COMMAND scope, falls back to malloc when full
+const size_t HOST_ALLOCATOR_POOL_CHUNK_SIZE = 64 * 1024;
+const size_t HOST_ALLOCATOR_MIN_SLOT_SIZE = 32;  // including the block header
+const size_t HOST_ALLOCATOR_MAX_SLOT_SIZE = 1024;
+
+const char PIPELINE_CACHE_FILE_NAME[] = "pipeline_cache.bin";  // next to the executable
+const uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x434C504D;  // "MPLC"
+
 const glm::vec3 VEC3_UP = glm::vec3(0.0f, 1.0f, 0.0f);
 
 MLC_NAMESPACE_END
\ No newline at end of file
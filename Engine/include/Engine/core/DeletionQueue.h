@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// Holds on to destroy calls until the GPU is done with what they destroy.
+// Every deleter is pushed with a serial and runs once Flush() is told that
+// serial has completed. Serials have to be pushed in non-decreasing order.
+class DeletionQueue
+{
+public:
+    DeletionQueue() = default;
+    ~DeletionQueue() = default;
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+    DeletionQueue(DeletionQueue&& other) noexcept = default;
+    DeletionQueue& operator=(DeletionQueue&& other) noexcept = default;
+
+    void Push(uint64_t serial, std::function<void()> deleter);
+    void Flush(uint64_t completed_serial);
+    // Only when nothing can be in use anymore, e.g. after vkDeviceWaitIdle
+    void FlushAll();
+
+    MLC_NODISCARD bool IsEmpty() const;
+
+private:
+    struct Deletion
+    {
+        uint64_t serial;
+        std::function<void()> deleter;
+    };
+
+    std::deque<Deletion> m_deletions;
+};
+
+MLC_NAMESPACE_END
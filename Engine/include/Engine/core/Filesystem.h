@@ -23,4 +23,8 @@ private:
     std::string m_path;
 };
 
+// Directory the running executable is in, for files that belong to a build
+// rather than to the project
+MLC_NODISCARD std::filesystem::path GetExecutableDirectory();
+
 MLC_NAMESPACE_END
\ No newline at end of file
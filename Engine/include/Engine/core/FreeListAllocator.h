@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// Hands out [offset, offset + size) ranges from a fixed-size address space.
+// It doesn't own any memory, callers map the offsets onto whatever they manage
+// (device memory blocks, buffer regions, ...).
+class FreeListAllocator
+{
+public:
+    static constexpr uint64_t INVALID_OFFSET = UINT64_MAX;
+
+public:
+    FreeListAllocator() = default;
+    explicit FreeListAllocator(uint64_t size);
+    ~FreeListAllocator() = default;
+    FreeListAllocator(const FreeListAllocator&) = default;
+    FreeListAllocator& operator=(const FreeListAllocator&) = default;
+    FreeListAllocator(FreeListAllocator&& other) noexcept = default;
+    FreeListAllocator& operator=(FreeListAllocator&& other) noexcept = default;
+
+    // Returns INVALID_OFFSET if there's no free range big enough
+    MLC_NODISCARD uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+    // size has to be the same size that was passed to Allocate()
+    void Free(uint64_t offset, uint64_t size);
+    void Reset();
+
+    MLC_NODISCARD uint64_t GetSize() const;
+    MLC_NODISCARD uint64_t GetUsedSize() const;
+    MLC_NODISCARD bool IsEmpty() const;
+
+private:
+    uint64_t m_size = 0;
+    uint64_t m_usedSize = 0;
+    std::map<uint64_t, uint64_t> m_freeRanges;  // offset -> size, sorted so neighbours can be merged
+};
+
+MLC_NAMESPACE_END
\ No newline at end of file
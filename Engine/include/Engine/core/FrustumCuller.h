@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// Bounding spheres kept as structure of arrays, so the frustum test runs on
+// 8 (AVX) or 4 (SSE) spheres per instruction. Fill it, cull, clear it next frame.
+class FrustumCuller
+{
+public:
+    FrustumCuller() = default;
+    ~FrustumCuller() = default;
+
+    void Clear();
+    void Reserve(uint32_t count);
+    // Center in xyz, radius in w. A radius of 0 or less is always visible.
+    void Add(const glm::vec4& sphere);
+    MLC_NODISCARD uint32_t GetCount() const;
+
+    // Planes point inwards with normalized xyz. `visibility` gets a 1 for every
+    // sphere that's at least partly inside all of them, a 0 otherwise.
+    void Cull(const std::array<glm::vec4, 6>& planes, std::vector<uint8_t>& visibility) const;
+
+private:
+    std::vector<float> m_centerX;
+    std::vector<float> m_centerY;
+    std::vector<float> m_centerZ;
+    std::vector<float> m_radius;  // never culled ones are stored as infinity
+};
+
+MLC_NAMESPACE_END
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// boost::hash_combine, widened to 64 bits
+void HashCombine(uint64_t& hash, uint64_t value);
+// Combines `size` bytes a word at a time, structs hashed this way shouldn't have padding
+void HashBytes(uint64_t& hash, const void* data, size_t size);
+
+// Byte-wise equality to go with HashBytes, same rule about padding
+template<typename T>
+bool SameBytes(const std::vector<T>& a, const std::vector<T>& b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), sizeof(T) * a.size()) == 0);
+}
+
+MLC_NAMESPACE_END
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+struct SortItem
+{
+    uint64_t key;
+    uint32_t index;  // whatever the key was made for
+};
+
+// Stable LSD radix sort on the keys, a byte per pass. Passes where every key
+// has the same byte are skipped, so keys with unused bits stay cheap.
+// `scratch` is resized as needed, keep it around to avoid reallocating.
+void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+
+MLC_NAMESPACE_END
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// Hands out ranges from a fixed-size address space in FIFO order. Ranges are
+// handed back in batches: everything allocated before a Retire(serial) call is
+// freed once Reclaim() is told that serial has completed on the GPU.
+class RingAllocator
+{
+public:
+    static constexpr uint64_t INVALID_OFFSET = UINT64_MAX;
+
+public:
+    RingAllocator() = default;
+    explicit RingAllocator(uint64_t size);
+    ~RingAllocator() = default;
+    RingAllocator(const RingAllocator&) = default;
+    RingAllocator& operator=(const RingAllocator&) = default;
+    RingAllocator(RingAllocator&& other) noexcept = default;
+    RingAllocator& operator=(RingAllocator&& other) noexcept = default;
+
+    // Returns INVALID_OFFSET if the ring is too full, Reclaim() and try again
+    MLC_NODISCARD uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+    // Everything allocated since the last Retire() is in use until `serial` completes
+    void Retire(uint64_t serial);
+    void Reclaim(uint64_t completed_serial);
+
+    MLC_NODISCARD bool HasRetired() const;
+    MLC_NODISCARD uint64_t GetOldestRetiredSerial() const;
+    MLC_NODISCARD uint64_t GetSize() const;
+    MLC_NODISCARD uint64_t GetUsedSize() const;
+
+private:
+    struct RetiredRange
+    {
+        uint64_t end;
+        uint64_t size;  // including alignment/wrap padding
+        uint64_t serial;
+    };
+
+    uint64_t m_size = 0;
+    uint64_t m_head = 0;  // next allocation starts here
+    uint64_t m_tail = 0;  // oldest range still in use starts here
+    uint64_t m_usedSize = 0;
+    uint64_t m_unretiredSize = 0;
+    std::deque<RetiredRange> m_retiredRanges;
+};
+
+MLC_NAMESPACE_END
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// Worker threads for work that shouldn't hold up the frame. Unlike ThreadPool
+// nobody waits on a task, Push() returns right away and the task runs whenever
+// a worker gets to it. Tasks report back through whatever they captured.
+class TaskQueue
+{
+public:
+    TaskQueue() = default;
+    ~TaskQueue();
+    TaskQueue(const TaskQueue&) = delete;
+    TaskQueue& operator=(const TaskQueue&) = delete;
+
+    void Start(uint32_t worker_count);
+    // Tasks that haven't started are dropped, running ones are waited for
+    void Stop();
+
+    // Runs on the calling thread if there are no workers
+    void Push(std::function<void()> task);
+    // Blocks until every pushed task has run
+    void WaitIdle();
+
+private:
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_taskAvailable;
+    std::condition_variable m_idle;
+    std::deque<std::function<void()>> m_tasks;
+    uint32_t m_runningTasks = 0;
+    bool m_stopping = false;
+
+private:
+    void _WorkerLoop();
+};
+
+MLC_NAMESPACE_END
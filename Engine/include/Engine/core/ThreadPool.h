@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Engine/core/Defines.h"
+
+MLC_NAMESPACE_START
+
+// A fixed set of worker threads for splitting up per-frame work. Run() hands
+// job indices out to the workers and the calling thread, and only returns once
+// every job is done, so jobs can reference the caller's stack.
+class ThreadPool
+{
+public:
+    ThreadPool() = default;
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Start(uint32_t worker_count);
+    void Stop();
+
+    // Workers plus the thread calling Run()
+    MLC_NODISCARD uint32_t GetThreadCount() const;
+
+    // Every index in [0, job_count) runs exactly once. Only one Run() at a time.
+    void Run(uint32_t job_count, const std::function<void(uint32_t job_index)>& job);
+
+private:
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_workDone;
+    const std::function<void(uint32_t)>* m_job = nullptr;
+    uint32_t m_jobCount = 0;
+    std::atomic<uint32_t> m_nextJob = 0;
+    uint32_t m_busyWorkers = 0;
+    uint64_t m_generation = 0;  // bumped by every Run(), wakes the workers
+    bool m_stopping = false;
+
+private:
+    void _WorkerLoop();
+    void _ProcessJobs();
+};
+
+MLC_NAMESPACE_END
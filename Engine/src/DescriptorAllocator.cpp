@@ -0,0 +1,190 @@
+#include "Engine/DescriptorAllocator.h"
+
+#include <algorithm>
+
+#include "Engine/core/Config.h"
+#include "Engine/core/Assert.h"
+#include "Engine/core/Hash.h"
+
+MLC_NAMESPACE_START
+
+void DescriptorAllocator::Init(VkDevice device, const std::vector<VkDescriptorPoolSize>& sizes_per_set)
+{
+    MLC_ASSERT(m_device == VK_NULL_HANDLE, "DescriptorAllocator was already initialized.");
+    m_device = device;
+    m_sizesPerSet = sizes_per_set;
+    m_nextPoolSets = DESCRIPTOR_POOL_INITIAL_SETS;
+}
+
+void DescriptorAllocator::ShutDown()
+{
+    if (m_currentPool != VK_NULL_HANDLE)
+    {
+        m_fullPools.push_back(m_currentPool);
+        m_currentPool = VK_NULL_HANDLE;
+    }
+    for (VkDescriptorPool pool : m_fullPools)
+    {
+        vkDestroyDescriptorPool(m_device, pool, MLC_VULKAN_ALLOCATOR);
+    }
+    m_fullPools.clear();
+    m_device = VK_NULL_HANDLE;
+}
+
+VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+    if (m_currentPool == VK_NULL_HANDLE)
+    {
+        m_currentPool = _NextPool();
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .descriptorPool = m_currentPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout
+    };
+    VkDescriptorSet descriptorSet;
+    VkResult result = vkAllocateDescriptorSets(m_device, &allocateInfo, &descriptorSet);
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    {
+        m_fullPools.push_back(m_currentPool);
+        m_currentPool = _NextPool();
+        allocateInfo.descriptorPool = m_currentPool;
+        result = vkAllocateDescriptorSets(m_device, &allocateInfo, &descriptorSet);
+    }
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate descriptor set.");
+
+    return descriptorSet;
+}
+
+VkDescriptorPool DescriptorAllocator::_NextPool()
+{
+    std::vector<VkDescriptorPoolSize> poolSizes = m_sizesPerSet;
+    for (VkDescriptorPoolSize& poolSize : poolSizes)
+    {
+        poolSize.descriptorCount *= m_nextPoolSets;
+    }
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .maxSets = m_nextPoolSets,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data()
+    };
+    VkDescriptorPool pool;
+    VkResult result = vkCreateDescriptorPool(m_device, &descriptorPoolCreateInfo, MLC_VULKAN_ALLOCATOR, &pool);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create descriptor pool.");
+
+    m_nextPoolSets = std::min(m_nextPoolSets * 2, DESCRIPTOR_POOL_MAX_SETS);
+    return pool;
+}
+
+void DescriptorSetLayoutCache::Init(VkDevice device)
+{
+    m_device = device;
+}
+
+void DescriptorSetLayoutCache::ShutDown()
+{
+    for (auto& [hash, cached] : m_layouts)
+    {
+        vkDestroyDescriptorSetLayout(m_device, cached.layout, MLC_VULKAN_ALLOCATOR);
+    }
+    m_layouts.clear();
+    m_device = VK_NULL_HANDLE;
+}
+
+VkDescriptorSetLayout DescriptorSetLayoutCache::GetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                                          VkDescriptorSetLayoutCreateFlags flags,
+                                                          const std::vector<VkDescriptorBindingFlags>& binding_flags)
+{
+    MLC_ASSERT(binding_flags.empty() || binding_flags.size() == bindings.size(),
+               "Binding flags don't match the bindings.");
+
+    // Binding order doesn't change the layout
+    std::vector<uint32_t> order(bindings.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&bindings](uint32_t a, uint32_t b) {
+        return bindings[a].binding < bindings[b].binding;
+    });
+    std::vector<VkDescriptorSetLayoutBinding> sortedBindings;
+    std::vector<VkDescriptorBindingFlags> sortedBindingFlags;
+    for (uint32_t i : order)
+    {
+        sortedBindings.push_back(bindings[i]);
+        if (!binding_flags.empty())
+        {
+            sortedBindingFlags.push_back(binding_flags[i]);
+        }
+    }
+
+    uint64_t hash = 0;
+    HashCombine(hash, flags);
+    HashCombine(hash, sortedBindings.size());
+    for (uint32_t i = 0; i < sortedBindings.size(); i++)
+    {
+        const VkDescriptorSetLayoutBinding& binding = sortedBindings[i];
+        HashCombine(hash, binding.binding);
+        HashCombine(hash, binding.descriptorType);
+        HashCombine(hash, binding.descriptorCount);
+        HashCombine(hash, binding.stageFlags);
+        HashCombine(hash, reinterpret_cast<uintptr_t>(binding.pImmutableSamplers));
+        HashCombine(hash, sortedBindingFlags.empty() ? 0 : sortedBindingFlags[i]);
+    }
+
+    auto sameBinding = [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+        return a.binding == b.binding &&
+               a.descriptorType == b.descriptorType &&
+               a.descriptorCount == b.descriptorCount &&
+               a.stageFlags == b.stageFlags &&
+               a.pImmutableSamplers == b.pImmutableSamplers;
+    };
+    auto [first, last] = m_layouts.equal_range(hash);
+    for (auto it = first; it != last; it++)
+    {
+        const CachedLayout& cached = it->second;
+        if (cached.flags == flags &&
+            cached.bindingFlags == sortedBindingFlags &&
+            std::equal(cached.bindings.begin(), cached.bindings.end(),
+                       sortedBindings.begin(), sortedBindings.end(),
+                       sameBinding))
+        {
+            return cached.layout;
+        }
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .bindingCount = static_cast<uint32_t>(sortedBindingFlags.size()),
+        .pBindingFlags = sortedBindingFlags.data()
+    };
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = sortedBindingFlags.empty() ? VK_NULL_HANDLE : &bindingFlagsCreateInfo,
+        .flags = flags,
+        .bindingCount = static_cast<uint32_t>(sortedBindings.size()),
+        .pBindings = sortedBindings.data()
+    };
+    VkDescriptorSetLayout layout;
+    VkResult result = vkCreateDescriptorSetLayout(m_device,
+                                                  &descriptorSetLayoutCreateInfo,
+                                                  MLC_VULKAN_ALLOCATOR,
+                                                  &layout);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create descriptor set layout.");
+    m_layouts.emplace(hash, CachedLayout {
+        .flags = flags,
+        .bindings = std::move(sortedBindings),
+        .bindingFlags = std::move(sortedBindingFlags),
+        .layout = layout
+    });
+    return layout;
+}
+
+MLC_NAMESPACE_END
@@ -0,0 +1,305 @@
+#include "Engine/DeviceMemoryAllocator.h"
+
+#include <algorithm>
+
+#include "Engine/core/Config.h"
+#include "Engine/core/Assert.h"
+#include "Engine/core/Logging.h"
+
+MLC_NAMESPACE_START
+
+void DeviceMemoryAllocator::Init(VkPhysicalDevice physical_device, VkDevice device, bool memory_budget_supported)
+{
+    m_physicalDevice = physical_device;
+    m_device = device;
+    m_memoryBudgetSupported = memory_budget_supported;
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &m_memoryProperties);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physical_device, &deviceProperties);
+    m_nonCoherentAtomSize = std::max<VkDeviceSize>(deviceProperties.limits.nonCoherentAtomSize, 1);
+
+    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+    {
+        m_heapStats[i] = MemoryHeapStats {
+            .heapSize = m_memoryProperties.memoryHeaps[i].size
+        };
+    }
+}
+
+void DeviceMemoryAllocator::ShutDown()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (uint32_t poolIndex = 0; poolIndex < m_pools.size(); poolIndex++)
+    {
+        uint32_t memoryTypeIndex = poolIndex / 2;
+        for (MemoryBlock& block : m_pools[poolIndex].blocks)
+        {
+            if (!block.ranges.IsEmpty())
+            {
+                MLC_WARN("Device memory block [{}] still has {} bytes in use.",
+                         static_cast<void*>(block.memory),
+                         block.ranges.GetUsedSize());
+            }
+            _FreeMemory(memoryTypeIndex, block.memory, block.ranges.GetSize());
+        }
+        m_pools[poolIndex].blocks.clear();
+    }
+    m_outOfMemoryHandler = nullptr;
+    m_device = VK_NULL_HANDLE;
+    m_physicalDevice = VK_NULL_HANDLE;
+}
+
+DeviceAllocation DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& requirements,
+                                                 VkMemoryPropertyFlags properties,
+                                                 DeviceResourceKind kind)
+{
+    uint32_t memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
+    VkMemoryPropertyFlags typeProperties = m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+    uint32_t heapIndex = GetHeapIndex(memoryTypeIndex);
+
+    // Non-coherent memory is flushed in atoms, don't let two resources share one
+    VkDeviceSize alignment = requirements.alignment;
+    VkDeviceSize size = requirements.size;
+    if ((typeProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+        !(typeProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+    {
+        alignment = std::max(alignment, m_nonCoherentAtomSize);
+        size = (size + m_nonCoherentAtomSize - 1) / m_nonCoherentAtomSize * m_nonCoherentAtomSize;
+    }
+
+    DeviceAllocation allocation {
+        .memory = VK_NULL_HANDLE,
+        .offset = 0,
+        .size = size,
+        .mappedData = nullptr,
+        .memoryTypeIndex = memoryTypeIndex,
+        .kind = kind,
+        .dedicated = false
+    };
+
+    while (!_TryAllocate(allocation, alignment))
+    {
+        bool freedMemory = m_outOfMemoryHandler && m_outOfMemoryHandler(heapIndex, size);
+        if (!freedMemory)
+        {
+            MLC_ERROR("Out of device memory in heap {} allocating {} bytes.", heapIndex, size);
+            MLC_ASSERT(false, "Out of device memory.");
+            break;
+        }
+    }
+
+    return allocation;
+}
+
+void DeviceMemoryAllocator::Free(DeviceAllocation& allocation)
+{
+    MLC_ASSERT(allocation.memory != VK_NULL_HANDLE, "Device allocation is VK_NULL_HANDLE.");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t heapIndex = m_memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex;
+    m_heapStats[heapIndex].usedBytes -= allocation.size;
+    m_heapStats[heapIndex].allocationCount--;
+
+    if (allocation.dedicated)
+    {
+        _FreeMemory(allocation.memoryTypeIndex, allocation.memory, allocation.size);
+    }
+    else
+    {
+        MemoryPool& pool = m_pools[allocation.memoryTypeIndex * 2 + static_cast<uint32_t>(allocation.kind)];
+        auto it = std::find_if(pool.blocks.begin(), pool.blocks.end(), [&](const MemoryBlock& block) {
+            return block.memory == allocation.memory;
+        });
+        MLC_ASSERT(it != pool.blocks.end(), "Device allocation doesn't belong to this allocator.");
+
+        it->ranges.Free(allocation.offset, allocation.size);
+
+        // Keep one empty block around so a create/destroy loop doesn't hit vkAllocateMemory every time
+        if (it->ranges.IsEmpty() && pool.blocks.size() > 1)
+        {
+            _FreeMemory(allocation.memoryTypeIndex, it->memory, it->ranges.GetSize());
+            pool.blocks.erase(it);
+        }
+    }
+
+    allocation = DeviceAllocation {};
+}
+
+uint32_t DeviceMemoryAllocator::FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const
+{
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+    {
+        if ((type_filter & (1 << i)) &&
+            (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+    MLC_ASSERT(false, "Failed to find suitable device memory type.");
+    return static_cast<uint32_t>(-1);
+}
+
+uint32_t DeviceMemoryAllocator::GetHeapIndex(uint32_t memory_type_index) const
+{
+    return m_memoryProperties.memoryTypes[memory_type_index].heapIndex;
+}
+
+std::vector<MemoryHeapStats> DeviceMemoryAllocator::GetHeapStats() const
+{
+    std::vector<MemoryHeapStats> heapStats;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        heapStats.assign(m_heapStats.begin(), m_heapStats.begin() + m_memoryProperties.memoryHeapCount);
+    }
+
+    if (m_memoryBudgetSupported)
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+            .pNext = VK_NULL_HANDLE
+        };
+        VkPhysicalDeviceMemoryProperties2 memoryProperties {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext = &budgetProperties
+        };
+        vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memoryProperties);
+
+        for (uint32_t i = 0; i < heapStats.size(); i++)
+        {
+            heapStats[i].budget = budgetProperties.heapBudget[i];
+            heapStats[i].usage = budgetProperties.heapUsage[i];
+        }
+    }
+    else
+    {
+        // No idea what other processes use, assume most of the heap is ours
+        for (MemoryHeapStats& stats : heapStats)
+        {
+            stats.budget = stats.heapSize / 10 * 8;
+            stats.usage = stats.blockBytes;
+        }
+    }
+
+    return heapStats;
+}
+
+void DeviceMemoryAllocator::SetOutOfMemoryHandler(OutOfDeviceMemoryHandler handler)
+{
+    m_outOfMemoryHandler = std::move(handler);
+}
+
+bool DeviceMemoryAllocator::_TryAllocate(DeviceAllocation& allocation, VkDeviceSize alignment)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t memoryTypeIndex = allocation.memoryTypeIndex;
+    VkDeviceSize size = allocation.size;
+    VkDeviceSize blockSize = _GetBlockSize(memoryTypeIndex);
+    if (size > blockSize / 2)
+    {
+        // Big resources (render targets, huge textures) would just waste the rest of a block
+        allocation.memory = _AllocateMemory(memoryTypeIndex, size, &allocation.mappedData);
+        if (allocation.memory == VK_NULL_HANDLE) return false;
+        allocation.dedicated = true;
+    }
+    else
+    {
+        MemoryPool& pool = m_pools[memoryTypeIndex * 2 + static_cast<uint32_t>(allocation.kind)];
+        for (MemoryBlock& block : pool.blocks)
+        {
+            uint64_t offset = block.ranges.Allocate(size, alignment);
+            if (offset == FreeListAllocator::INVALID_OFFSET) continue;
+
+            allocation.memory = block.memory;
+            allocation.offset = offset;
+            allocation.mappedData = block.mappedData;
+            break;
+        }
+
+        if (allocation.memory == VK_NULL_HANDLE)
+        {
+            void* mappedData;
+            VkDeviceMemory memory = _AllocateMemory(memoryTypeIndex, blockSize, &mappedData);
+            if (memory == VK_NULL_HANDLE) return false;
+
+            MemoryBlock& block = pool.blocks.emplace_back();
+            block.memory = memory;
+            block.mappedData = mappedData;
+            block.ranges = FreeListAllocator(blockSize);
+
+            allocation.memory = block.memory;
+            allocation.offset = block.ranges.Allocate(size, alignment);
+            allocation.mappedData = block.mappedData;
+        }
+    }
+
+    if (allocation.mappedData)
+    {
+        allocation.mappedData = static_cast<char*>(allocation.mappedData) + allocation.offset;
+    }
+
+    uint32_t heapIndex = GetHeapIndex(memoryTypeIndex);
+    m_heapStats[heapIndex].usedBytes += size;
+    m_heapStats[heapIndex].allocationCount++;
+
+    return true;
+}
+
+VkDeviceSize DeviceMemoryAllocator::_GetBlockSize(uint32_t memory_type_index) const
+{
+    uint32_t heapIndex = m_memoryProperties.memoryTypes[memory_type_index].heapIndex;
+    VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[heapIndex].size;
+
+    // Small heaps (e.g. the 256MB BAR heap) would run out after a few blocks
+    if (heapSize <= DEVICE_MEMORY_SMALL_HEAP_SIZE)
+    {
+        return heapSize / 8;
+    }
+    return DEVICE_MEMORY_BLOCK_SIZE;
+}
+
+VkDeviceMemory DeviceMemoryAllocator::_AllocateMemory(uint32_t memory_type_index, VkDeviceSize size, void** mapped_data)
+{
+    VkMemoryAllocateInfo allocInfo {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .allocationSize = size,
+        .memoryTypeIndex = memory_type_index
+    };
+
+    VkDeviceMemory memory;
+    VkResult result = vkAllocateMemory(m_device, &allocInfo, MLC_VULKAN_ALLOCATOR, &memory);
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+    {
+        return VK_NULL_HANDLE;
+    }
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate device memory block.");
+
+    *mapped_data = nullptr;
+    if (m_memoryProperties.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        result = vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mapped_data);
+        MLC_ASSERT(result == VK_SUCCESS, "Failed to map device memory block.");
+    }
+
+    MemoryHeapStats& heapStats = m_heapStats[m_memoryProperties.memoryTypes[memory_type_index].heapIndex];
+    heapStats.blockBytes += size;
+    heapStats.blockCount++;
+
+    return memory;
+}
+
+void DeviceMemoryAllocator::_FreeMemory(uint32_t memory_type_index, VkDeviceMemory memory, VkDeviceSize size)
+{
+    // Freeing implicitly unmaps
+    vkFreeMemory(m_device, memory, MLC_VULKAN_ALLOCATOR);
+
+    MemoryHeapStats& heapStats = m_heapStats[m_memoryProperties.memoryTypes[memory_type_index].heapIndex];
+    heapStats.blockBytes -= size;
+    heapStats.blockCount--;
+}
+
+MLC_NAMESPACE_END
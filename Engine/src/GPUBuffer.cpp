@@ -8,29 +8,33 @@ GPUBuffer::~GPUBuffer()
 {
     MLC_ASSERT(m_handle == VK_NULL_HANDLE,
                fmt::format("GPUBuffer handle [{}] was not destroyed.", static_cast<void*>(m_handle)));
-    MLC_ASSERT(m_memory == VK_NULL_HANDLE,
-               fmt::format("GPUBuffer memory [{}] was not deallocated.", static_cast<void*>(m_memory)));
+    MLC_ASSERT(m_allocation.memory == VK_NULL_HANDLE,
+               fmt::format("GPUBuffer memory [{}] was not deallocated.", static_cast<void*>(m_allocation.memory)));
 }
 
 GPUBuffer::GPUBuffer(GPUBuffer&& other) noexcept
 {
     m_handle = other.m_handle;
-    m_memory = other.m_memory;
+    m_allocation = other.m_allocation;
+    m_size = other.m_size;
     m_properties = other.m_properties;
 
     other.m_handle = VK_NULL_HANDLE;
-    other.m_memory = VK_NULL_HANDLE;
+    other.m_allocation = DeviceAllocation {};
+    other.m_size = 0;
     other.m_properties = 0;
 }
 
 GPUBuffer& GPUBuffer::operator=(GPUBuffer&& other) noexcept
 {
     m_handle = other.m_handle;
-    m_memory = other.m_memory;
+    m_allocation = other.m_allocation;
+    m_size = other.m_size;
     m_properties = other.m_properties;
 
     other.m_handle = VK_NULL_HANDLE;
-    other.m_memory = VK_NULL_HANDLE;
+    other.m_allocation = DeviceAllocation {};
+    other.m_size = 0;
     other.m_properties = 0;
 
     return *this;
@@ -38,7 +42,12 @@ GPUBuffer& GPUBuffer::operator=(GPUBuffer&& other) noexcept
 
 bool GPUBuffer::IsUsable() const
 {
-    return m_handle != VK_NULL_HANDLE && m_memory != VK_NULL_HANDLE;
+    return m_handle != VK_NULL_HANDLE && m_allocation.memory != VK_NULL_HANDLE;
+}
+
+VkDeviceSize GPUBuffer::GetSize() const
+{
+    return m_size;
 }
 
 MLC_NAMESPACE_END
\ No newline at end of file
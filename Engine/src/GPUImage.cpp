@@ -8,29 +8,29 @@ GPUImage::~GPUImage()
 {
     MLC_ASSERT(m_handle == VK_NULL_HANDLE,
                fmt::format("GPUImage handle [{}] was not destroyed.", static_cast<void*>(m_handle)));
-    MLC_ASSERT(m_memory == VK_NULL_HANDLE,
-               fmt::format("GPUImage memory [{}] was not deallocated.", static_cast<void*>(m_memory)));
+    MLC_ASSERT(m_allocation.memory == VK_NULL_HANDLE,
+               fmt::format("GPUImage memory [{}] was not deallocated.", static_cast<void*>(m_allocation.memory)));
 }
 
 GPUImage::GPUImage(GPUImage&& other) noexcept
 {
     m_handle = other.m_handle;
-    m_memory = other.m_memory;
+    m_allocation = other.m_allocation;
     m_properties = other.m_properties;
 
     other.m_handle = VK_NULL_HANDLE;
-    other.m_memory = VK_NULL_HANDLE;
+    other.m_allocation = DeviceAllocation {};
     other.m_properties = 0;
 }
 
 GPUImage& GPUImage::operator=(GPUImage&& other) noexcept
 {
     m_handle = other.m_handle;
-    m_memory = other.m_memory;
+    m_allocation = other.m_allocation;
     m_properties = other.m_properties;
 
     other.m_handle = VK_NULL_HANDLE;
-    other.m_memory = VK_NULL_HANDLE;
+    other.m_allocation = DeviceAllocation {};
     other.m_properties = 0;
 
     return *this;
@@ -38,7 +38,12 @@ GPUImage& GPUImage::operator=(GPUImage&& other) noexcept
 
 bool GPUImage::IsUsable() const
 {
-    return m_handle != VK_NULL_HANDLE && m_memory != VK_NULL_HANDLE;
+    return m_handle != VK_NULL_HANDLE && m_allocation.memory != VK_NULL_HANDLE;
+}
+
+VkDeviceSize GPUImage::GetSize() const
+{
+    return m_allocation.size;
 }
 
 MLC_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,15 @@
+#include "Engine/GraphicsPipeline.h"
+
+MLC_NAMESPACE_START
+
+bool GraphicsPipeline::IsUsable() const
+{
+    return IsReady() && m_pipeline != VK_NULL_HANDLE;
+}
+
+bool GraphicsPipeline::IsReady() const
+{
+    return m_ready.load(std::memory_order_acquire);
+}
+
+MLC_NAMESPACE_END
@@ -16,6 +16,7 @@ Image2DViewer::Image2DViewer(Image2DViewer&& other) noexcept
 {
     m_imageView = other.m_imageView;
     m_sampler = other.m_sampler;
+    m_bindlessIndex = other.m_bindlessIndex;
 
     other.m_imageView = VK_NULL_HANDLE;
     other.m_sampler = VK_NULL_HANDLE;
@@ -25,6 +26,7 @@ Image2DViewer& Image2DViewer::operator=(Image2DViewer&& other) noexcept
 {
     m_imageView = other.m_imageView;
     m_sampler = other.m_sampler;
+    m_bindlessIndex = other.m_bindlessIndex;
 
     other.m_imageView = VK_NULL_HANDLE;
     other.m_sampler = VK_NULL_HANDLE;
@@ -38,4 +40,9 @@ bool Image2DViewer::IsUsable() const
            m_sampler != VK_NULL_HANDLE;
 }
 
+uint32_t Image2DViewer::GetBindlessIndex() const
+{
+    return m_bindlessIndex;
+}
+
 MLC_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "Engine/InstanceBuffer.h"
+
+#include "Engine/core/Assert.h"
+#include "Engine/VulkanManager.h"
+
+MLC_NAMESPACE_START
+
+InstanceBuffer::InstanceBuffer(const VulkanManager* vulkan_manager,
+                               const std::vector<InstanceData>& instances,
+                               UploadBatch* upload_batch)
+    : m_vulkanManager(vulkan_manager), m_instanceCount(static_cast<uint32_t>(instances.size()))
+{
+    MLC_ASSERT(!instances.empty(), "InstanceBuffer needs at least one instance.");
+
+    m_vulkanManager->AllocateBuffer(m_buffer,
+                                    sizeof(InstanceData) * instances.size(),
+                                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    _Upload(instances, 0, upload_batch, false);
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    if (m_vulkanManager)
+    {
+        m_vulkanManager->DeallocateBuffer(m_buffer);
+    }
+}
+
+InstanceBuffer::InstanceBuffer(InstanceBuffer&& other) noexcept
+{
+    m_vulkanManager = other.m_vulkanManager;
+    m_buffer = std::move(other.m_buffer);
+    m_instanceCount = other.m_instanceCount;
+    m_uploadTicket = other.m_uploadTicket;
+
+    other.m_vulkanManager = nullptr;
+    other.m_instanceCount = 0;
+}
+
+InstanceBuffer& InstanceBuffer::operator=(InstanceBuffer&& other) noexcept
+{
+    if (m_vulkanManager)
+    {
+        m_vulkanManager->DeallocateBuffer(m_buffer);
+    }
+
+    m_vulkanManager = other.m_vulkanManager;
+    m_buffer = std::move(other.m_buffer);
+    m_instanceCount = other.m_instanceCount;
+    m_uploadTicket = other.m_uploadTicket;
+
+    other.m_vulkanManager = nullptr;
+    other.m_instanceCount = 0;
+
+    return *this;
+}
+
+void InstanceBuffer::Update(const std::vector<InstanceData>& instances,
+                            uint32_t first_instance,
+                            UploadBatch* upload_batch)
+{
+    _Upload(instances, first_instance, upload_batch, true);
+}
+
+const GPUBuffer& InstanceBuffer::GetBuffer() const
+{
+    return m_buffer;
+}
+
+uint32_t InstanceBuffer::GetInstanceCount() const
+{
+    return m_instanceCount;
+}
+
+UploadTicket InstanceBuffer::GetUploadTicket() const
+{
+    return m_uploadTicket;
+}
+
+void InstanceBuffer::_Upload(const std::vector<InstanceData>& instances,
+                             uint32_t first_instance,
+                             UploadBatch* upload_batch,
+                             bool in_use)
+{
+    MLC_ASSERT(first_instance + instances.size() <= m_instanceCount, "Instances don't fit in the InstanceBuffer.");
+    if (instances.empty()) return;
+
+    VkDeviceSize size = sizeof(InstanceData) * instances.size();
+    VkDeviceSize offset = sizeof(InstanceData) * first_instance;
+    // Once it could have been drawn, the copy can't overwrite what frames in flight are reading
+    UploadBatch batch;
+    UploadBatch& target = upload_batch ? *upload_batch : batch;
+    if (in_use)
+    {
+        m_vulkanManager->QueueBufferRewrite(target, m_buffer, instances.data(), size, offset);
+    }
+    else
+    {
+        m_vulkanManager->QueueBufferUpload(target, m_buffer, instances.data(), size, offset);
+    }
+    m_uploadTicket = upload_batch ? UploadTicket {} : m_vulkanManager->SubmitUploadBatch(batch);
+}
+
+MLC_NAMESPACE_END
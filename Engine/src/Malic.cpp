@@ -53,12 +53,20 @@ void MalicEngine::Run()
     _WindowInit();
     m_vulkanManager.Init(m_window);
     m_resourceManager._Init(&m_vulkanManager);
+    m_vulkanManager.SetOutOfDeviceMemoryHandler([this](uint32_t heap_index, VkDeviceSize size) {
+        if (!m_resourceManager._EvictTextures(heap_index, size)) return false;
+        // Evicted memory is only given back after a few frames, the allocation can't wait for that
+        m_vulkanManager.FlushDeletionQueue();
+        return true;
+    });
     MalicEntry(this);
     _MainLoop();  // Everything has to live & die inside this Loop to ensure proper resource management
 }
 
 void MalicEngine::ShutDown()
 {
+    // Queued compiles use the resource manager's shader modules
+    m_vulkanManager.WaitForGraphicsPipelines();
     m_resourceManager._ShutDown();
     m_vulkanManager.ShutDown();
     _ShutDown();
@@ -69,6 +77,16 @@ const ResourceManager* MalicEngine::GetResourceManager() const
     return &m_resourceManager;
 }
 
+std::vector<MemoryHeapStats> MalicEngine::GetMemoryHeapStats() const
+{
+    return m_vulkanManager.GetMemoryHeapStats();
+}
+
+std::array<HostAllocationStats, VulkanHostAllocator::SCOPE_COUNT> MalicEngine::GetHostMemoryStats() const
+{
+    return VulkanHostAllocator::Get().GetStats();
+}
+
 bool MalicEngine::IsKeyPressed(uint32_t key) const
 {
     return glfwGetKey(m_window, key) == GLFW_PRESS;
@@ -102,9 +120,21 @@ void* MalicEngine::GetUserPointer() const
 }
 
 VertexArray MalicEngine::CreateVertexArray(const std::vector<Vertex>& vertices,
-                                           const std::vector<uint16_t>& indices) const
+                                           const std::vector<uint16_t>& indices,
+                                           UploadBatch* upload_batch) const
 {
-    return VertexArray(&m_vulkanManager, vertices, indices);
+    return VertexArray(&m_vulkanManager, vertices, indices, upload_batch);
+}
+
+InstanceBuffer MalicEngine::CreateInstanceBuffer(const std::vector<InstanceData>& instances,
+                                                UploadBatch* upload_batch) const
+{
+    return InstanceBuffer(&m_vulkanManager, instances, upload_batch);
+}
+
+UploadTicket MalicEngine::SubmitUploadBatch(UploadBatch& upload_batch) const
+{
+    return m_vulkanManager.SubmitUploadBatch(upload_batch);
 }
 
 void MalicEngine::CreateDescriptors(const std::vector<DescriptorInfo>& descriptor_infos)
@@ -115,15 +145,25 @@ void MalicEngine::CreateDescriptors(const std::vector<DescriptorInfo>& descripto
     m_vulkanManager.CreateDescriptorSets();
 }
 
-UniformBuffer MalicEngine::CreateUBO(uint32_t binding, VkDeviceSize size) const
+void MalicEngine::BindUniformRing(uint32_t binding, VkDeviceSize size_per_draw)
+{
+    m_vulkanManager.DescriptorSetBindUniformRing(binding, size_per_draw);
+}
+
+const GraphicsPipeline* MalicEngine::GetPipeline(const PipelineResources& pipeline_config)
 {
-    return UniformBuffer(&m_vulkanManager, binding, size);
+    return m_vulkanManager.GetGraphicsPipeline(pipeline_config);
 }
 
 void MalicEngine::AssignPipeline(const PipelineResources& pipeline_config)
 {
-    m_vulkanManager.DestroyGraphicsPipeline();
-    m_vulkanManager.CreateGraphicsPipeline(pipeline_config);
+    // The previous one stays cached, entries may still point at it
+    m_vulkanManager.SetDefaultGraphicsPipeline(m_vulkanManager.GetGraphicsPipeline(pipeline_config));
+}
+
+void MalicEngine::AssignFallbackPipeline(const PipelineResources& pipeline_config)
+{
+    m_vulkanManager.SetFallbackGraphicsPipeline(m_vulkanManager.GetGraphicsPipeline(pipeline_config));
 }
 
 void MalicEngine::AssignRenderList(const std::vector<RenderResources>& render_list)
@@ -131,6 +171,11 @@ void MalicEngine::AssignRenderList(const std::vector<RenderResources>& render_li
     m_renderList = render_list;
 }
 
+void MalicEngine::SetCullingFrustum(const glm::mat4& clip_from_instance)
+{
+    m_vulkanManager.SetCullingFrustum(clip_from_instance);
+}
+
 void MalicEngine::_WindowInit()
 {
     int glfwStatus = glfwInit();
@@ -187,7 +232,16 @@ void MalicEngine::_ShutDown()
 
 void MalicEngine::_DrawFrame()
 {
-    m_vulkanManager.Present(m_renderList[0]);
+    m_resourceManager._EnforceMemoryBudget();
+
+    for (const RenderResources& renderResources : m_renderList)
+    {
+        if (renderResources.material.GetAlbedo())
+        {
+            m_resourceManager._MakeResident(renderResources.material.GetAlbedo());
+        }
+    }
+    m_vulkanManager.Present(m_renderList);
 }
 
 MLC_NAMESPACE_END
\ No newline at end of file
@@ -13,7 +13,7 @@ Material::Material(Material&& other) noexcept
     m_shader = std::move(other.m_shader);
     m_albedo = other.m_albedo;
 
-    m_albedo = nullptr;
+    other.m_albedo = nullptr;
 }
 
 Material& Material::operator=(Material&& other) noexcept
@@ -21,7 +21,7 @@ Material& Material::operator=(Material&& other) noexcept
     m_shader = std::move(other.m_shader);
     m_albedo = other.m_albedo;
 
-    m_albedo = nullptr;
+    other.m_albedo = nullptr;
 
     return *this;
 }
@@ -1,6 +1,9 @@
 #include "Engine/ResourceManager.h"
 
 #include <unordered_map>
+#include <deque>
+#include <string>
+#include <algorithm>
 #include <fstream>
 
 #include "Engine/VulkanManager.h"
@@ -14,10 +17,10 @@ MLC_NAMESPACE_START
 // can access.
 static std::unordered_map<const char*, uint16_t> s_vertModuleIndices;
 static std::unordered_map<const char*, uint16_t> s_fragModuleIndices;
-static std::unordered_map<const char*, uint16_t> s_texture2DIndices;
+static std::unordered_map<std::string, uint16_t> s_texture2DIndices;
 static std::vector<VkShaderModule> s_vertModules;
 static std::vector<VkShaderModule> s_fragModules;
-static std::vector<Texture2D> s_texture2Ds;
+static std::deque<Texture2D> s_texture2Ds;  // handed out pointers can't move
 
 void ResourceManager::_Init(const VulkanManager* vulkan_manager)
 {
@@ -71,14 +74,26 @@ Shader ResourceManager::GetShader(const File& vert_file, const File& frag_file)
     );
 }
 
-const Texture2D* ResourceManager::GetTexture2D(const File& file) const
+const Texture2D* ResourceManager::GetTexture2D(const File& file, UploadBatch* upload_batch) const
 {
-    if (!s_texture2DIndices[file.GetPath()])
+    auto it = s_texture2DIndices.find(file.GetPath());
+    if (it == s_texture2DIndices.end())
     {
-        s_texture2Ds.emplace_back(m_vulkanManager, file);
-        s_texture2DIndices[file.GetPath()] = s_texture2Ds.size() - 1;
+        // Loaded after it's in s_texture2Ds, running out of memory evicts from there
+        Texture2D& texture = s_texture2Ds.emplace_back();
+        texture.m_vulkanManager = m_vulkanManager;
+        texture.m_path = file.GetPath();
+        it = s_texture2DIndices.emplace(file.GetPath(), s_texture2Ds.size() - 1).first;
     }
-    return &s_texture2Ds[s_texture2DIndices[file.GetPath()]];
+
+    Texture2D& texture = s_texture2Ds[it->second];
+    if (!texture.IsUsable())
+    {
+        texture._Load(upload_batch);
+    }
+    // Counts as used so it isn't evicted again before it's drawn
+    texture.MarkUsed(m_vulkanManager->GetFrameCount());
+    return &texture;
 }
 
 std::vector<char> ResourceManager::_GetFileBytecode(const File& file) const
@@ -98,4 +113,72 @@ std::vector<char> ResourceManager::_GetFileBytecode(const File& file) const
     return buffer;
 }
 
+bool ResourceManager::_EvictTextures(uint32_t heap_index, VkDeviceSize size)
+{
+    // Frames that may still be in flight could be sampling them
+    uint64_t frameCount = m_vulkanManager->GetFrameCount();
+    std::vector<Texture2D*> candidates;
+    for (Texture2D& texture : s_texture2Ds)
+    {
+        if (!texture.IsUsable()) continue;
+        if (texture.GetLastUsedFrame() + MAX_FRAMES_IN_FLIGHT >= frameCount) continue;
+        if (m_vulkanManager->GetMemoryHeapIndex(texture.m_image) != heap_index) continue;
+        candidates.push_back(&texture);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Texture2D* a, const Texture2D* b) {
+        return a->GetLastUsedFrame() < b->GetLastUsedFrame();
+    });
+
+    VkDeviceSize freedSize = 0;
+    for (Texture2D* texture : candidates)
+    {
+        if (freedSize >= size) break;
+
+        freedSize += texture->m_image.GetSize();
+        MLC_DEBUG("Evicting texture \"{}\" ({} bytes), last used in frame {}.",
+                  texture->m_path, texture->m_image.GetSize(), texture->GetLastUsedFrame());
+        texture->_Unload();
+    }
+
+    if (freedSize > 0)
+    {
+        // The memory comes back through VulkanManager's deletion queue once frameCount's frame is done
+        m_evictionReleaseFrame = frameCount + MAX_FRAMES_IN_FLIGHT + 1;
+    }
+    return freedSize > 0;
+}
+
+void ResourceManager::_EnforceMemoryBudget()
+{
+    // Heap stats don't show the last eviction yet, don't evict again for it
+    if (m_vulkanManager->GetFrameCount() < m_evictionReleaseFrame) return;
+
+    std::vector<MemoryHeapStats> heapStats = m_vulkanManager->GetMemoryHeapStats();
+    for (uint32_t heapIndex = 0; heapIndex < heapStats.size(); heapIndex++)
+    {
+        const MemoryHeapStats& stats = heapStats[heapIndex];
+
+        // Evicting frees sub-allocations, the blocks stay. Count our blocks by what's used
+        // in them, or evicting would never get usage under the target.
+        VkDeviceSize usage = stats.usage - std::min(stats.usage, stats.blockBytes) + stats.usedBytes;
+        VkDeviceSize threshold = static_cast<VkDeviceSize>(stats.budget * MEMORY_BUDGET_EVICTION_THRESHOLD);
+        if (usage <= threshold) continue;
+
+        VkDeviceSize target = static_cast<VkDeviceSize>(stats.budget * MEMORY_BUDGET_EVICTION_TARGET);
+        MLC_WARN("Device memory heap {} is over budget ({} / {} bytes), evicting textures.",
+                 heapIndex, usage, stats.budget);
+        _EvictTextures(heapIndex, usage - target);
+    }
+}
+
+void ResourceManager::_MakeResident(const Texture2D* texture)
+{
+    // Every Texture2D handed out lives in s_texture2Ds, it's only const for users
+    Texture2D* ownedTexture = const_cast<Texture2D*>(texture);
+    if (!ownedTexture->IsUsable())
+    {
+        ownedTexture->_Load(nullptr);
+    }
+}
+
 MLC_NAMESPACE_END
\ No newline at end of file
@@ -9,70 +9,28 @@ MLC_NAMESPACE_START
 
 // https://stackoverflow.com/questions/50403342/how-do-i-properly-use-stdstring-on-utf-8-in-c
 
-Texture2D::Texture2D(const VulkanManager* vulkan_manager, const File& file)
-    : m_vulkanManager(vulkan_manager)
+Texture2D::Texture2D(const VulkanManager* vulkan_manager, const File& file, UploadBatch* upload_batch)
+    : m_vulkanManager(vulkan_manager), m_path(file.GetPath())
 {
-    int width, height, channels;
-    
-#ifndef _WIN32
-    FILE* f = fopen(file.GetPath(), "rb");
-#else
-    std::string s(file.GetPath());
-    std::wstring filePathW;
-    filePathW.resize(s.length());
-    int newSize = MultiByteToWideChar(CP_UTF8, 0, s.c_str(), s.size(), const_cast<wchar_t *>(filePathW.c_str()), filePathW.length());
-    filePathW.resize(newSize);
-    FILE* f = _wfopen(filePathW.c_str(), L"rb");
-#endif
-
-    stbi_uc* pixels = stbi_load_from_file(f, &width, &height, &channels, STBI_rgb_alpha);
-    MLC_ASSERT(pixels != nullptr, fmt::format("Failed to load texture image data.\n{}", stbi_failure_reason()));
-    fclose(f);
-
-    VkDeviceSize size = width * height * 4;
-
-    GPUBuffer stagingBuffer;
-    vulkan_manager->AllocateBuffer(stagingBuffer,
-                                   size,
-                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    vulkan_manager->UploadBuffer(stagingBuffer, pixels, size);
-    stbi_image_free(pixels);
-    vulkan_manager->AllocateImage2D(m_image,
-                                    width,
-                                    height,
-                                    VK_FORMAT_R8G8B8A8_SRGB,
-                                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    vulkan_manager->TransitionImageLayout(m_image,
-                                          VK_FORMAT_R8G8B8A8_SRGB,
-                                          VK_IMAGE_LAYOUT_UNDEFINED,
-                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    vulkan_manager->CopyBufferToImage(stagingBuffer, m_image, width, height);
-    vulkan_manager->TransitionImageLayout(m_image,
-                                          VK_FORMAT_B8G8R8A8_SRGB,
-                                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    vulkan_manager->DeallocateBuffer(stagingBuffer);
-
-    vulkan_manager->CreateImage2DViewer(m_viewer, m_image, VK_FORMAT_R8G8B8A8_SRGB);
-    Bind();
+    _Load(upload_batch);
 }
 
 Texture2D::~Texture2D()
 {
-    if (m_vulkanManager)
+    if (m_vulkanManager && IsUsable())
     {
-        m_vulkanManager->DestroyImage2DViewer(m_viewer);
-        m_vulkanManager->DeallocateImage2D(m_image);
+        _Unload();
     }
 }
 
 Texture2D::Texture2D(Texture2D&& other) noexcept
 {
     m_vulkanManager = other.m_vulkanManager;
+    m_path = std::move(other.m_path);
     m_image = std::move(other.m_image);
     m_viewer = std::move(other.m_viewer);
+    m_uploadTicket = other.m_uploadTicket;
+    m_lastUsedFrame = other.m_lastUsedFrame;
 
     other.m_vulkanManager = nullptr;
 }
@@ -80,8 +38,11 @@ Texture2D::Texture2D(Texture2D&& other) noexcept
 Texture2D& Texture2D::operator=(Texture2D&& other) noexcept
 {
     m_vulkanManager = other.m_vulkanManager;
+    m_path = std::move(other.m_path);
     m_image = std::move(other.m_image);
     m_viewer = std::move(other.m_viewer);
+    m_uploadTicket = other.m_uploadTicket;
+    m_lastUsedFrame = other.m_lastUsedFrame;
 
     other.m_vulkanManager = nullptr;
 
@@ -93,9 +54,76 @@ bool Texture2D::IsUsable() const
     return m_image.IsUsable() && m_viewer.IsUsable();
 }
 
-void Texture2D::Bind() const
+UploadTicket Texture2D::GetUploadTicket() const
+{
+    return m_uploadTicket;
+}
+
+const Image2DViewer& Texture2D::GetViewer() const
+{
+    return m_viewer;
+}
+
+uint64_t Texture2D::GetLastUsedFrame() const
+{
+    return m_lastUsedFrame;
+}
+
+void Texture2D::MarkUsed(uint64_t frame) const
+{
+    m_lastUsedFrame = frame;
+}
+
+uint32_t Texture2D::GetBindlessIndex() const
+{
+    return m_viewer.GetBindlessIndex();
+}
+
+void Texture2D::_Load(UploadBatch* upload_batch)
+{
+    int width, height, channels;
+    
+#ifndef _WIN32
+    FILE* f = fopen(m_path.c_str(), "rb");
+#else
+    std::wstring filePathW;
+    filePathW.resize(m_path.length());
+    int newSize = MultiByteToWideChar(CP_UTF8, 0, m_path.c_str(), m_path.size(), const_cast<wchar_t *>(filePathW.c_str()), filePathW.length());
+    filePathW.resize(newSize);
+    FILE* f = _wfopen(filePathW.c_str(), L"rb");
+#endif
+
+    stbi_uc* pixels = stbi_load_from_file(f, &width, &height, &channels, STBI_rgb_alpha);
+    MLC_ASSERT(pixels != nullptr, fmt::format("Failed to load texture image data.\n{}", stbi_failure_reason()));
+    fclose(f);
+
+    VkDeviceSize size = width * height * 4;
+
+    m_vulkanManager->AllocateImage2D(m_image,
+                                     width,
+                                     height,
+                                     VK_FORMAT_R8G8B8A8_SRGB,
+                                     VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (upload_batch)
+    {
+        m_vulkanManager->QueueImage2DUpload(*upload_batch, m_image, pixels, size, width, height);
+        m_uploadTicket = UploadTicket {};
+    }
+    else
+    {
+        m_uploadTicket = m_vulkanManager->UploadImage2DAsync(m_image, pixels, size, width, height);
+    }
+    stbi_image_free(pixels);
+
+    // Goes into the bindless texture table, draws pick it by its index
+    m_vulkanManager->CreateImage2DViewer(m_viewer, m_image, VK_FORMAT_R8G8B8A8_SRGB);
+}
+
+void Texture2D::_Unload()
 {
-    m_vulkanManager->DescriptorSetBindImage2D(m_viewer);
+    m_vulkanManager->DestroyImage2DViewer(m_viewer);
+    m_vulkanManager->DeallocateImage2D(m_image);
 }
 
 MLC_NAMESPACE_END
\ No newline at end of file
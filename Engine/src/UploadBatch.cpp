@@ -0,0 +1,21 @@
+#include "Engine/UploadBatch.h"
+
+#include "Engine/core/Assert.h"
+
+MLC_NAMESPACE_START
+
+UploadBatch::~UploadBatch()
+{
+    // Queued staging memory stays reserved in the ring until the batch is submitted
+    MLC_ASSERT(IsEmpty() && !m_holdsStaging, "UploadBatch was destroyed without being submitted.");
+}
+
+bool UploadBatch::IsEmpty() const
+{
+    return m_preCopyBarriers.empty() &&
+           m_bufferCopies.empty() &&
+           m_imageCopies.empty() &&
+           m_postCopyBarriers.empty();
+}
+
+MLC_NAMESPACE_END
@@ -6,121 +6,97 @@ MLC_NAMESPACE_START
 
 VertexArray::VertexArray(const VulkanManager* vulkan_manager,
                          const std::vector<Vertex>& vertices,
-                         const std::vector<uint16_t>& indices)
-    : m_vulkanManager(vulkan_manager),
-      m_verticesCount(static_cast<uint32_t>(vertices.size())),
-      m_indicesCount(static_cast<uint32_t>(indices.size()))
+                         const std::vector<uint16_t>& indices,
+                         UploadBatch* upload_batch)
+    : m_vulkanManager(vulkan_manager)
 {
-    // TODO: vkBindBufferMemory2: Bind multiple buffers at once
-    // vkBindBufferMemory2(VkDevice device, uint32_t bindInfoCount, const VkBindBufferMemoryInfo *pBindInfos)
-
-    GPUBuffer stagingBuffer;
-
-    // Upload vertex buffer
-    m_vulkanManager->AllocateBuffer(stagingBuffer,
-                                    vertices.size() * sizeof(Vertex),
-                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);    
-    m_vulkanManager->AllocateBuffer(m_vertexBuffer,
-                                    vertices.size() * sizeof(Vertex),
-                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    m_vulkanManager->UploadBuffer(stagingBuffer,
-                                  vertices.data(),
-                                  sizeof(Vertex) * vertices.size());
-    m_vulkanManager->CopyBuffer(stagingBuffer, m_vertexBuffer, sizeof(Vertex) * vertices.size());
-    m_vulkanManager->DeallocateBuffer(stagingBuffer);
-
-    // Upload index buffer
-    m_vulkanManager->AllocateBuffer(stagingBuffer,
-                                    sizeof(uint16_t) * indices.size(),
-                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    m_vulkanManager->AllocateBuffer(m_indexBuffer,
-                                    sizeof(uint16_t) * indices.size(),
-                                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    m_vulkanManager->UploadBuffer(stagingBuffer,
-                                  indices.data(),
-                                  sizeof(uint16_t) * indices.size());
-    m_vulkanManager->CopyBuffer(stagingBuffer, m_indexBuffer, sizeof(uint16_t) * indices.size());
-    m_vulkanManager->DeallocateBuffer(stagingBuffer);
+    m_geometry = m_vulkanManager->AllocateGeometry(static_cast<uint32_t>(vertices.size()),
+                                                   static_cast<uint32_t>(indices.size()));
+
+    // Both ranges go out in one submission, either the caller's or our own
+    UploadBatch ownBatch;
+    UploadBatch& batch = upload_batch ? *upload_batch : ownBatch;
+    m_vulkanManager->QueueGeometryUpload(batch, m_geometry, vertices.data(), indices.data());
+    if (!upload_batch)
+    {
+        m_uploadTicket = m_vulkanManager->SubmitUploadBatch(ownBatch);
+    }
 }
                                     
 VertexArray::~VertexArray()
 {
-    // Note: When performing move semantics, buffer handles with value VK_NULL_HANDLE
-    // can be safely called with vkDestroyBuffer, but of course it can't be
-    // used with other functions, which can prevent implicitly ownership of buffers.
-    // Since I've made it so that if m_vulkanManager is null, other members are also null.
-    // This way we can check if we should delete resources depending on if m_vulkanManager
-    // is null.
+    // Note: Moved-from VertexArrays have a null m_vulkanManager and an empty
+    // range, so only the owner gives the range back.
     if (m_vulkanManager)
     {
-        m_vulkanManager->DeallocateBuffer(m_vertexBuffer);
-        m_vulkanManager->DeallocateBuffer(m_indexBuffer);
+        m_vulkanManager->DeallocateGeometry(m_geometry);
     }
 }
 
 VertexArray::VertexArray(VertexArray&& other) noexcept
 {
     m_vulkanManager = other.m_vulkanManager;
-    m_verticesCount = other.m_verticesCount;
-    m_indicesCount = other.m_indicesCount;
-    m_vertexBuffer = std::move(other.m_vertexBuffer);
-    m_indexBuffer = std::move(other.m_indexBuffer);
+    m_geometry = other.m_geometry;
+    m_uploadTicket = other.m_uploadTicket;
 
     other.m_vulkanManager = nullptr;
-    other.m_verticesCount = static_cast<uint32_t>(-1);
-    other.m_indicesCount = static_cast<uint32_t>(-1);
+    other.m_geometry = GeometryRange {};
 }
 
 VertexArray& VertexArray::operator=(VertexArray&& other) noexcept
 {
+    if (m_vulkanManager)
+    {
+        m_vulkanManager->DeallocateGeometry(m_geometry);
+    }
+
     m_vulkanManager = other.m_vulkanManager;
-    m_verticesCount = other.m_verticesCount;
-    m_indicesCount = other.m_indicesCount;
-    m_vertexBuffer = std::move(other.m_vertexBuffer);
-    m_indexBuffer = std::move(other.m_indexBuffer);
+    m_geometry = other.m_geometry;
+    m_uploadTicket = other.m_uploadTicket;
     
     other.m_vulkanManager = nullptr;
-    other.m_verticesCount = static_cast<uint32_t>(-1);
-    other.m_indicesCount = static_cast<uint32_t>(-1);
+    other.m_geometry = GeometryRange {};
 
     return *this;
 }
 
 uint32_t VertexArray::GetVerticesCount() const
 {
-    return m_verticesCount;
+    return m_geometry.vertexCount;
 }
 
 uint32_t VertexArray::GetIndicesCount() const
 {
-    return m_indicesCount;
+    return m_geometry.indexCount;
 }
 
-const GPUBuffer& VertexArray::GetVertexBuffer() const
+uint32_t VertexArray::GetFirstVertex() const
 {
-    MLC_ASSERT(m_vertexBuffer.IsUsable(), "Vertex Array not initialized.");
-
-    return m_vertexBuffer;
+    return m_geometry.firstVertex;
 }
 
-const GPUBuffer& VertexArray::GetIndexBuffer() const
+uint32_t VertexArray::GetFirstIndex() const
 {
-    MLC_ASSERT(m_indexBuffer.IsUsable(), "Vertex Array not initialized.");
+    return m_geometry.firstIndex;
+}
 
-    return m_indexBuffer;
+UploadTicket VertexArray::GetUploadTicket() const
+{
+    return m_uploadTicket;
 }
 
 std::vector<VkVertexInputBindingDescription> VertexArray::GetBindingDescriptions() const
 {
     return {
         VkVertexInputBindingDescription {
-            .binding = 0,
+            .binding = VERTEX_BINDING_INDEX_VERTEX,
             .stride = sizeof(Vertex),
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX  // can be per instance
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        },
+        VkVertexInputBindingDescription {
+            .binding = VERTEX_BINDING_INDEX_INSTANCE,
+            .stride = sizeof(InstanceData),
+            .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
         }
     };
 }
@@ -148,11 +124,36 @@ std::vector<VkVertexInputAttributeDescription> VertexArray::GetAttribDescription
         .offset = offsetof(Vertex, uv)
     };
 
-    return {
+    std::vector<VkVertexInputAttributeDescription> attribDescs {
         positionAttribDesc,
         colorAttribDesc,
         uvAttribDesc
     };
+
+    // Instance stream
+    for (uint32_t column = 0; column < 4; column++)
+    {
+        attribDescs.push_back(VkVertexInputAttributeDescription {
+            .location = VERTEX_ATTRIB_INDEX_INSTANCE_TRANSFORM + column,
+            .binding = bindingDescs[1].binding,
+            .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+            .offset = static_cast<uint32_t>(offsetof(InstanceData, transform) + sizeof(glm::vec4) * column)
+        });
+    }
+    attribDescs.push_back(VkVertexInputAttributeDescription {
+        .location = VERTEX_ATTRIB_INDEX_INSTANCE_TINT,
+        .binding = bindingDescs[1].binding,
+        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+        .offset = offsetof(InstanceData, tint)
+    });
+    attribDescs.push_back(VkVertexInputAttributeDescription {
+        .location = VERTEX_ATTRIB_INDEX_INSTANCE_ALBEDO,
+        .binding = bindingDescs[1].binding,
+        .format = VK_FORMAT_R32_UINT,
+        .offset = offsetof(InstanceData, albedoIndex)
+    });
+
+    return attribDescs;
 }
 
 MLC_NAMESPACE_END
\ No newline at end of file
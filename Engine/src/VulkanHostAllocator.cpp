@@ -0,0 +1,305 @@
+#include "Engine/VulkanHostAllocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "Engine/core/Config.h"
+#include "Engine/core/Logging.h"
+
+MLC_NAMESPACE_START
+
+static_assert(sizeof(void*) <= HOST_ALLOCATOR_MIN_SLOT_SIZE / 2, "Free slots have to fit a pointer.");
+
+static const char* SCOPE_NAMES[] = {
+    "COMMAND",
+    "OBJECT",
+    "CACHE",
+    "DEVICE",
+    "INSTANCE"
+};
+
+static uintptr_t AlignUp(uintptr_t address, size_t alignment)
+{
+    return (address + alignment - 1) / alignment * alignment;
+}
+
+VulkanHostAllocator::VulkanHostAllocator()
+{
+    m_callbacks = VkAllocationCallbacks {
+        .pUserData = this,
+        .pfnAllocation = &_AllocationCallback,
+        .pfnReallocation = &_ReallocationCallback,
+        .pfnFree = &_FreeCallback,
+        .pfnInternalAllocation = &_InternalAllocationCallback,
+        .pfnInternalFree = &_InternalFreeCallback
+    };
+
+    m_arena = static_cast<char*>(std::malloc(HOST_ALLOCATOR_ARENA_SIZE));
+
+    size_t slotPoolCount = 0;
+    for (size_t slotSize = HOST_ALLOCATOR_MIN_SLOT_SIZE; slotSize <= HOST_ALLOCATOR_MAX_SLOT_SIZE; slotSize <<= 1)
+    {
+        slotPoolCount++;
+    }
+    m_slotPools.resize(slotPoolCount);
+}
+
+VulkanHostAllocator::~VulkanHostAllocator()
+{
+    // Whatever the driver still holds points into these, leave them to the OS
+    for (const HostAllocationStats& stats : m_stats)
+    {
+        if (stats.currentBytes > 0) return;
+    }
+
+    std::free(m_arena);
+    for (SlotPool& pool : m_slotPools)
+    {
+        for (void* chunk : pool.chunks)
+        {
+            std::free(chunk);
+        }
+    }
+}
+
+VulkanHostAllocator& VulkanHostAllocator::Get()
+{
+    static VulkanHostAllocator allocator;
+    return allocator;
+}
+
+const VkAllocationCallbacks* VulkanHostAllocator::GetCallbacks() const
+{
+    return &m_callbacks;
+}
+
+std::array<HostAllocationStats, VulkanHostAllocator::SCOPE_COUNT> VulkanHostAllocator::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void VulkanHostAllocator::LogStats() const
+{
+    std::array<HostAllocationStats, SCOPE_COUNT> stats = GetStats();
+    for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++)
+    {
+        if (stats[scope].allocationCount == 0 && stats[scope].internalBytes == 0) continue;
+
+        MLC_INFO("Vulkan host memory [{}]: {} bytes held (peak {}), {} allocs, {} reallocs, {} frees, {} internal bytes",
+                 SCOPE_NAMES[scope],
+                 stats[scope].currentBytes,
+                 stats[scope].peakBytes,
+                 stats[scope].allocationCount,
+                 stats[scope].reallocationCount,
+                 stats[scope].freeCount,
+                 stats[scope].internalBytes);
+    }
+}
+
+void* VulkanHostAllocator::_Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    alignment = std::max(alignment, alignof(BlockHeader));
+
+    BlockHeader header {
+        .size = size,
+        .padding = 0,
+        .source = BlockSource::HEAP,
+        .scope = static_cast<uint8_t>(scope),
+        .sizeClass = 0,
+        .reserved = 0
+    };
+
+    void* memory = nullptr;
+    if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+    {
+        memory = _AllocateFromArena(size, alignment);
+        header.source = BlockSource::ARENA;
+    }
+    else if (scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT &&
+             alignment <= sizeof(BlockHeader) &&
+             size + sizeof(BlockHeader) <= HOST_ALLOCATOR_MAX_SLOT_SIZE)
+    {
+        memory = _AllocateFromPool(size, header.sizeClass);
+        header.source = BlockSource::POOL;
+    }
+
+    if (!memory)
+    {
+        memory = _AllocateFromHeap(size, alignment, header.padding);
+        header.source = BlockSource::HEAP;
+        if (!memory) return nullptr;
+    }
+
+    memcpy(static_cast<char*>(memory) - sizeof(BlockHeader), &header, sizeof(BlockHeader));
+
+    HostAllocationStats& stats = m_stats[scope];
+    stats.currentBytes += size;
+    stats.peakBytes = std::max(stats.peakBytes, stats.currentBytes);
+
+    return memory;
+}
+
+void VulkanHostAllocator::_Free(void* memory)
+{
+    char* block = static_cast<char*>(memory) - sizeof(BlockHeader);
+    BlockHeader header;
+    memcpy(&header, block, sizeof(BlockHeader));
+
+    m_stats[header.scope].currentBytes -= header.size;
+
+    switch (header.source)
+    {
+    case BlockSource::ARENA:
+        // Rewind once every COMMAND scope allocation is gone. Calls overlapping on other threads
+        // can keep it from draining, allocations that don't fit fall back to the heap until then.
+        if (--m_arenaLiveCount == 0)
+        {
+            m_arenaOffset = 0;
+        }
+        break;
+    case BlockSource::POOL:
+    {
+        SlotPool& pool = m_slotPools[header.sizeClass];
+        *reinterpret_cast<void**>(block) = pool.freeList;
+        pool.freeList = block;
+        break;
+    }
+    case BlockSource::HEAP:
+        std::free(static_cast<char*>(memory) - header.padding);
+        break;
+    }
+}
+
+void* VulkanHostAllocator::_AllocateFromArena(size_t size, size_t alignment)
+{
+    if (!m_arena) return nullptr;
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(m_arena);
+    uintptr_t address = AlignUp(base + m_arenaOffset + sizeof(BlockHeader), alignment);
+    if (address + size > base + HOST_ALLOCATOR_ARENA_SIZE) return nullptr;
+
+    m_arenaOffset = address + size - base;
+    m_arenaLiveCount++;
+    return reinterpret_cast<void*>(address);
+}
+
+void* VulkanHostAllocator::_AllocateFromPool(size_t size, uint8_t& size_class)
+{
+    size_t slotSize = HOST_ALLOCATOR_MIN_SLOT_SIZE;
+    size_class = 0;
+    while (slotSize < size + sizeof(BlockHeader))
+    {
+        slotSize <<= 1;
+        size_class++;
+    }
+
+    SlotPool& pool = m_slotPools[size_class];
+    if (!pool.freeList)
+    {
+        char* chunk = static_cast<char*>(std::malloc(HOST_ALLOCATOR_POOL_CHUNK_SIZE));
+        if (!chunk) return nullptr;
+        pool.chunks.push_back(chunk);
+
+        for (size_t offset = 0; offset + slotSize <= HOST_ALLOCATOR_POOL_CHUNK_SIZE; offset += slotSize)
+        {
+            *reinterpret_cast<void**>(chunk + offset) = pool.freeList;
+            pool.freeList = chunk + offset;
+        }
+    }
+
+    char* slot = static_cast<char*>(pool.freeList);
+    pool.freeList = *reinterpret_cast<void**>(slot);
+    return slot + sizeof(BlockHeader);
+}
+
+void* VulkanHostAllocator::_AllocateFromHeap(size_t size, size_t alignment, uint32_t& padding)
+{
+    char* block = static_cast<char*>(std::malloc(size + alignment + sizeof(BlockHeader)));
+    if (!block) return nullptr;
+
+    uintptr_t base = reinterpret_cast<uintptr_t>(block);
+    uintptr_t address = AlignUp(base + sizeof(BlockHeader), alignment);
+    padding = static_cast<uint32_t>(address - base);
+    return reinterpret_cast<void*>(address);
+}
+
+void* VulkanHostAllocator::_AllocationCallback(void* user_data,
+                                               size_t size,
+                                               size_t alignment,
+                                               VkSystemAllocationScope scope)
+{
+    VulkanHostAllocator* allocator = static_cast<VulkanHostAllocator*>(user_data);
+    std::lock_guard<std::mutex> lock(allocator->m_mutex);
+
+    allocator->m_stats[scope].allocationCount++;
+    return allocator->_Allocate(size, alignment, scope);
+}
+
+void* VulkanHostAllocator::_ReallocationCallback(void* user_data,
+                                                 void* original,
+                                                 size_t size,
+                                                 size_t alignment,
+                                                 VkSystemAllocationScope scope)
+{
+    VulkanHostAllocator* allocator = static_cast<VulkanHostAllocator*>(user_data);
+    std::lock_guard<std::mutex> lock(allocator->m_mutex);
+
+    allocator->m_stats[scope].reallocationCount++;
+    if (!original)
+    {
+        return allocator->_Allocate(size, alignment, scope);
+    }
+    if (size == 0)
+    {
+        allocator->_Free(original);
+        return nullptr;
+    }
+
+    BlockHeader header;
+    memcpy(&header, static_cast<char*>(original) - sizeof(BlockHeader), sizeof(BlockHeader));
+
+    // On failure the original has to stay untouched
+    void* memory = allocator->_Allocate(size, alignment, scope);
+    if (!memory) return nullptr;
+
+    memcpy(memory, original, std::min<size_t>(header.size, size));
+    allocator->_Free(original);
+    return memory;
+}
+
+void VulkanHostAllocator::_FreeCallback(void* user_data, void* memory)
+{
+    if (!memory) return;
+
+    VulkanHostAllocator* allocator = static_cast<VulkanHostAllocator*>(user_data);
+    std::lock_guard<std::mutex> lock(allocator->m_mutex);
+
+    BlockHeader header;
+    memcpy(&header, static_cast<char*>(memory) - sizeof(BlockHeader), sizeof(BlockHeader));
+    allocator->m_stats[header.scope].freeCount++;
+    allocator->_Free(memory);
+}
+
+void VulkanHostAllocator::_InternalAllocationCallback(void* user_data,
+                                                      size_t size,
+                                                      VkInternalAllocationType,
+                                                      VkSystemAllocationScope scope)
+{
+    VulkanHostAllocator* allocator = static_cast<VulkanHostAllocator*>(user_data);
+    std::lock_guard<std::mutex> lock(allocator->m_mutex);
+    allocator->m_stats[scope].internalBytes += size;
+}
+
+void VulkanHostAllocator::_InternalFreeCallback(void* user_data,
+                                                size_t size,
+                                                VkInternalAllocationType,
+                                                VkSystemAllocationScope scope)
+{
+    VulkanHostAllocator* allocator = static_cast<VulkanHostAllocator*>(user_data);
+    std::lock_guard<std::mutex> lock(allocator->m_mutex);
+    allocator->m_stats[scope].internalBytes -= size;
+}
+
+MLC_NAMESPACE_END
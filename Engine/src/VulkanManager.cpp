@@ -4,11 +4,16 @@
 #include <algorithm>
 #include <array>
 #include <set>
+#include <fstream>
+#include <chrono>
+#include <cstring>
 
 #include "Engine/core/Config.h"
 #include "Engine/core/Assert.h"
 #include "Engine/core/Debug.h"
 #include "Engine/core/Logging.h"
+#include "Engine/core/Filesystem.h"
+#include "Engine/core/Hash.h"
 #include "Engine/VertexArray.h"
 #include "Engine/Material.h"
 
@@ -23,6 +28,61 @@ MLC_NAMESPACE_START
 static std::unordered_map<std::string_view, bool> s_supportedExtensions;
 static std::unordered_map<std::string_view, bool> s_supportedLayers;
 
+// Written in front of the driver's cache data. The driver checks its own header
+// too, but that one has no driver version and some drivers don't check it well
+struct PipelineCacheFileHeader
+{
+    uint32_t magic;
+    uint32_t dataSize;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+// Per-frame parts of the culling buffers line up with the instance and indirect rings
+static const uint32_t MAX_RING_INSTANCES_PER_FRAME = INSTANCE_RING_SIZE_PER_FRAME / sizeof(InstanceData);
+static_assert(sizeof(InstanceData) % 16 == 0, "cull.comp reads InstanceData as a std430 struct.");
+static const uint32_t MAX_INDIRECT_COMMANDS_PER_FRAME = INDIRECT_RING_SIZE_PER_FRAME / sizeof(VkDrawIndexedIndirectCommand);
+
+static VkDeviceSize AlignStorageOffset(VkDeviceSize size)
+{
+    // minStorageBufferOffsetAlignment is 256 at most
+    return (size + 255) / 256 * 256;
+}
+
+static bool ReadShaderBytecode(const File& shader_file, std::vector<char>& bytecode)
+{
+    std::ifstream fileStream(shader_file.GetPath(), std::ios::binary | std::ios::ate);
+    if (!fileStream.is_open()) return false;
+
+    bytecode.resize(static_cast<size_t>(fileStream.tellg()));
+    fileStream.seekg(0);
+    fileStream.read(bytecode.data(), bytecode.size());
+    return true;
+}
+
+static void RecordMemoryBarrier(VkCommandBuffer command_buffer,
+                                VkPipelineStageFlags src_stages,
+                                VkAccessFlags src_access,
+                                VkPipelineStageFlags dst_stages,
+                                VkAccessFlags dst_access)
+{
+    VkMemoryBarrier memoryBarrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = VK_NULL_HANDLE,
+        .srcAccessMask = src_access,
+        .dstAccessMask = dst_access
+    };
+    vkCmdPipelineBarrier(command_buffer,
+                         src_stages,
+                         dst_stages,
+                         0,
+                         1, &memoryBarrier,
+                         0, nullptr,
+                         0, nullptr);
+}
+
 void VulkanManager::Init(GLFWwindow* window)
 {
     // Note: Every vkCreateXXX has a mandatory vkDestroyXXX
@@ -33,6 +93,7 @@ void VulkanManager::Init(GLFWwindow* window)
         return;
     }
     m_window = window;
+    auto initStart = std::chrono::steady_clock::now();
 
     if (ENABLE_VALIDATION_LAYERS)
     {
@@ -43,21 +104,46 @@ void VulkanManager::Init(GLFWwindow* window)
     _CreateSurface();
     _PickPhysicalDevice();
     _CreateLogicalDevice();
+    _CreatePipelineCache();
+    m_descriptorSetLayoutCache.Init(m_device);
+    m_memoryAllocator.Init(m_physicalDevice, m_device, m_memoryBudgetSupported);
     _GetQueues();
     _CreateSwapChain();
     _CreateSwapChainImageViews();
-    _CreateRenderPass();
+    if (!m_dynamicRendering)
+    {
+        _CreateRenderPass();
+    }
     _CreateCommandPools();
     _CreateCommandBuffers();
+    // The main thread records too
+    m_recordingThreads.Start(std::clamp(std::thread::hardware_concurrency(), 1u, MAX_RECORDING_THREADS) - 1);
+    _CreateRetainedCommands();
+    m_pipelineCompileThreads.Start(PIPELINE_COMPILE_THREADS);
     _CreateDepthResources();
-    _CreateFramebuffers();
+    if (!m_dynamicRendering)
+    {
+        _CreateFramebuffers();
+    }
     _CreateSyncObjects();
-
-    MLC_INFO("Vulkan Initialization: Success");
+    _CreateUploadTimeline();
+    _CreateStagingBuffer();
+    _CreateGeometryArena();
+    _CreateUniformRing();
+    _CreateInstanceRing();
+    _CreateIndirectRing();
+    _CreateBindlessTextures();
+    _CreateCulling();
+
+    std::chrono::duration<double, std::milli> initTime = std::chrono::steady_clock::now() - initStart;
+    MLC_INFO("Vulkan Initialization: Success ({:.2f} ms)", initTime.count());
 }
 
 void VulkanManager::ShutDown()
 {
+    // The device is idle by now, nothing queued for deletion is in use
+    m_deletionQueue.FlushAll();
+
     for (uint32_t i = 0; i < m_swapChainImages.size(); i++)
     {
         vkDestroySemaphore(m_device, m_renderFinishedSemaphores[i], MLC_VULKAN_ALLOCATOR);
@@ -70,8 +156,13 @@ void VulkanManager::ShutDown()
         m_imageAvailableSemaphores[i] = VK_NULL_HANDLE;
         m_inFlightFences[i] = VK_NULL_HANDLE;
     }
+    vkDestroySemaphore(m_device, m_uploadTimeline, MLC_VULKAN_ALLOCATOR);
+    m_uploadTimeline = VK_NULL_HANDLE;
+    m_pendingUploadCmdBuffers.clear();  // freed with the transfer command pool
     vkDestroySwapchainKHR(m_device, m_swapChain, MLC_VULKAN_ALLOCATOR);
     m_swapChain = VK_NULL_HANDLE;
+    m_recordingThreads.Stop();
+    _DestroyRetainedCommands();
     vkDestroyCommandPool(m_device, m_graphicsCmdPool, MLC_VULKAN_ALLOCATOR);
     vkDestroyCommandPool(m_device, m_transferCmdPool, MLC_VULKAN_ALLOCATOR);
     m_graphicsCmdPool = VK_NULL_HANDLE;
@@ -86,21 +177,34 @@ void VulkanManager::ShutDown()
     // TODO: Since it doesn't really mater what order resource is deleted
     // (thanks to VkDeviceWaitIdle)
     // maybe I should relocate pipeline cleanup to somewhere else
-    vkDestroyDescriptorPool(m_device, m_descriptorPool, MLC_VULKAN_ALLOCATOR);
-    m_descriptorPool = VK_NULL_HANDLE;
-    vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, MLC_VULKAN_ALLOCATOR);
-    m_descriptorSetLayout = VK_NULL_HANDLE;
-    vkDestroyPipeline(m_device, m_graphicsPipeline, MLC_VULKAN_ALLOCATOR);
-    m_graphicsPipeline = VK_NULL_HANDLE;
-    vkDestroyPipelineLayout(m_device, m_pipelineLayout, MLC_VULKAN_ALLOCATOR);
-    m_pipelineLayout = VK_NULL_HANDLE;
+    m_descriptorAllocator.ShutDown();
+    m_pipelineCompileThreads.Stop();
+    DestroyGraphicsPipelines();
     vkDestroyRenderPass(m_device, m_renderPass, MLC_VULKAN_ALLOCATOR);
     m_renderPass = VK_NULL_HANDLE;
+    vkDestroyRenderPass(m_device, m_earlyRenderPass, MLC_VULKAN_ALLOCATOR);
+    m_earlyRenderPass = VK_NULL_HANDLE;
+    vkDestroyRenderPass(m_device, m_lateRenderPass, MLC_VULKAN_ALLOCATOR);
+    m_lateRenderPass = VK_NULL_HANDLE;
     for (size_t i = 0; i < m_swapChainImageViews.size(); i++)
     {
         vkDestroyImageView(m_device, m_swapChainImageViews[i], MLC_VULKAN_ALLOCATOR);
         m_swapChainImageViews[i] = VK_NULL_HANDLE;
     }
+    _DestroyCulling();
+    _DestroyBindlessTextures();
+    _DestroyIndirectRing();
+    _DestroyInstanceRing();
+    _DestroyUniformRing();
+    _DestroyGeometryArena();
+    _DestroyStagingBuffer();
+    m_deletionQueue.FlushAll();
+    _SavePipelineCache();
+    vkDestroyPipelineCache(m_device, m_pipelineCache, MLC_VULKAN_ALLOCATOR);
+    m_pipelineCache = VK_NULL_HANDLE;
+    m_descriptorSetLayoutCache.ShutDown();
+    m_descriptorSetLayout = VK_NULL_HANDLE;
+    m_memoryAllocator.ShutDown();
     vkDestroyDevice(m_device, MLC_VULKAN_ALLOCATOR);
     m_device = VK_NULL_HANDLE;
     vkDestroySurfaceKHR(m_instance, m_surface, MLC_VULKAN_ALLOCATOR);
@@ -115,10 +219,13 @@ void VulkanManager::ShutDown()
 
     m_window = nullptr;
 
+    // Peaks, and anything the driver didn't give back
+    VulkanHostAllocator::Get().LogStats();
+
     MLC_INFO("Vulkan Deinitialization: Success");
 }
 
-void VulkanManager::Present(const RenderResources& render_resources)
+void VulkanManager::Present(const std::vector<RenderResources>& render_list)
 {
     vkWaitForFences(m_device, 1, &m_inFlightFences[m_currentFrameIndex], VK_TRUE, UINT64_MAX);
     
@@ -139,22 +246,75 @@ void VulkanManager::Present(const RenderResources& render_resources)
     }
 
     vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrameIndex]);
+    // The fence means the frame MAX_FRAMES_IN_FLIGHT ago is done, and every upload it waited for
+    if (m_frameCount >= MAX_FRAMES_IN_FLIGHT)
+    {
+        m_deletionQueue.Flush(m_frameCount - MAX_FRAMES_IN_FLIGHT);
+    }
+    _ReclaimUploads();
+
+    // Nothing changed since this frame in flight was last built, the GPU is done with it and it can go out again
+    uint64_t drawStateHash = _HashDrawState(render_list);
+    RetainedDraws& retainedDraws = m_retainedDraws[m_currentFrameIndex];
+    if (retainedDraws.buildId == 0 || retainedDraws.drawStateHash != drawStateHash)
+    {
+        _BuildRetainedDraws(render_list);
+        retainedDraws.drawStateHash = drawStateHash;
+    }
+    else
+    {
+        _ReuseRetainedDraws();
+    }
+
+    if (_IsCullingActive())
+    {
+        // Not part of the recorded commands, so the camera can move without rebuilding them
+        std::memcpy(static_cast<char*>(m_cullFrustumBuffer.m_allocation.mappedData) +
+                    m_currentFrameIndex * AlignStorageOffset(sizeof(glm::mat4)),
+                    &m_cullingMatrix,
+                    sizeof(glm::mat4));
+    }
 
-    vkResetCommandBuffer(m_graphicsCmdBuffers[m_currentFrameIndex], 0);
-    _RecordCommandBuffer(m_graphicsCmdBuffers[m_currentFrameIndex], imageIndex, render_resources);
+    RetainedCommands& retainedCommands = m_retainedCommands[m_currentFrameIndex * m_swapChainImages.size() + imageIndex];
+    if (retainedCommands.buildId != retainedDraws.buildId)
+    {
+        for (const RecordingContext& context : retainedCommands.recordingContexts)
+        {
+            vkResetCommandPool(m_device, context.commandPool, 0);
+        }
+        _RecordCommandBuffer(retainedCommands.primaryCmdBuffer, imageIndex);
+        retainedCommands.buildId = retainedDraws.buildId;
+    }
 
-    std::array<VkSemaphore, 1> waitSemaphores = { m_imageAvailableSemaphores[m_currentFrameIndex] };  // waiting for next image
-    std::array<VkPipelineStageFlags, 1> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    // Waiting for next image and for every upload submitted so far
+    std::array<VkSemaphore, 2> waitSemaphores = {
+        m_imageAvailableSemaphores[m_currentFrameIndex],
+        m_uploadTimeline
+    };
+    std::array<VkPipelineStageFlags, 2> waitStages = {
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+    };
+    std::array<uint64_t, 2> waitValues = { 0, m_uploadTimelineValue };  // binary semaphores ignore their value
     std::array<VkSemaphore, 1> signalSemaphores = { m_renderFinishedSemaphores[imageIndex] };
 
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .waitSemaphoreValueCount = waitValues.size(),
+        .pWaitSemaphoreValues = waitValues.data(),
+        .signalSemaphoreValueCount = 0,
+        .pSignalSemaphoreValues = nullptr
+    };
+
     VkSubmitInfo submitInfo {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = VK_NULL_HANDLE,
+        .pNext = &timelineSubmitInfo,
         .waitSemaphoreCount = waitSemaphores.size(),
         .pWaitSemaphores = waitSemaphores.data(),
         .pWaitDstStageMask = waitStages.data(),
         .commandBufferCount = 1,
-        .pCommandBuffers = &m_graphicsCmdBuffers[m_currentFrameIndex],
+        .pCommandBuffers = &retainedCommands.primaryCmdBuffer,
         .signalSemaphoreCount = signalSemaphores.size(),
         .pSignalSemaphores = signalSemaphores.data()
     };
@@ -186,6 +346,7 @@ void VulkanManager::Present(const RenderResources& render_resources)
     }
 
     m_currentFrameIndex = (m_currentFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
+    m_frameCount++;
 }
 
 void VulkanManager::WaitIdle()
@@ -193,6 +354,12 @@ void VulkanManager::WaitIdle()
     vkDeviceWaitIdle(m_device);
 }
 
+void VulkanManager::FlushDeletionQueue()
+{
+    vkDeviceWaitIdle(m_device);
+    m_deletionQueue.FlushAll();
+}
+
 void VulkanManager::ResizeFramebuffer()
 {
     m_framebufferResized = true;
@@ -203,6 +370,48 @@ uint32_t VulkanManager::GetCurrentFrameInFlight() const
     return m_currentFrameIndex;
 }
 
+uint64_t VulkanManager::GetFrameCount() const
+{
+    return m_frameCount;
+}
+
+std::vector<MemoryHeapStats> VulkanManager::GetMemoryHeapStats() const
+{
+    return m_memoryAllocator.GetHeapStats();
+}
+
+uint32_t VulkanManager::GetMemoryHeapIndex(const GPUImage& image) const
+{
+    return m_memoryAllocator.GetHeapIndex(image.m_allocation.memoryTypeIndex);
+}
+
+void VulkanManager::SetOutOfDeviceMemoryHandler(OutOfDeviceMemoryHandler handler)
+{
+    m_memoryAllocator.SetOutOfMemoryHandler(std::move(handler));
+}
+
+void VulkanManager::SetCullingFrustum(const glm::mat4& clip_from_instance)
+{
+    // Planes come out of the matrix's rows (Gribb & Hartmann), clip space depth is 0 to w
+    auto row = [&clip_from_instance](int i) {
+        return glm::vec4(clip_from_instance[0][i], clip_from_instance[1][i], clip_from_instance[2][i], clip_from_instance[3][i]);
+    };
+    m_cullingPlanes = {
+        row(3) + row(0),  // left
+        row(3) - row(0),  // right
+        row(3) + row(1),  // bottom
+        row(3) - row(1),  // top
+        row(2),           // near
+        row(3) - row(2)   // far
+    };
+    for (glm::vec4& plane : m_cullingPlanes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    m_cullingMatrix = clip_from_instance;
+    m_hasCullingFrustum = true;
+}
+
 void VulkanManager::AllocateBuffer(GPUBuffer& buffer,
                                    VkDeviceSize size,
                                    VkBufferUsageFlags usage,
@@ -238,38 +447,36 @@ void VulkanManager::AllocateBuffer(GPUBuffer& buffer,
     VkMemoryRequirements memoryRequirements;
     vkGetBufferMemoryRequirements(m_device, buffer.m_handle, &memoryRequirements);
 
-    VkMemoryAllocateInfo allocInfo {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .allocationSize = memoryRequirements.size,
-        .memoryTypeIndex = _FindMemoryType(memoryRequirements.memoryTypeBits, properties)
-    };
-
-    result = vkAllocateMemory(m_device, &allocInfo, MLC_VULKAN_ALLOCATOR, &buffer.m_memory);
-    MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate vertex buffer memory.");
+    buffer.m_allocation = m_memoryAllocator.Allocate(memoryRequirements, properties, DeviceResourceKind::LINEAR);
 
-    vkBindBufferMemory(m_device, buffer.m_handle, buffer.m_memory, 0);
+    result = vkBindBufferMemory(m_device, buffer.m_handle, buffer.m_allocation.memory, buffer.m_allocation.offset);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to bind vertex buffer memory.");
 
+    buffer.m_size = size;
     buffer.m_properties = properties;
 }
 
 void VulkanManager::DeallocateBuffer(GPUBuffer& buffer) const
 {
     MLC_ASSERT(buffer.m_handle != VK_NULL_HANDLE, "Buffer handle is VK_NULL_HANDLE.");
-    MLC_ASSERT(buffer.m_memory != VK_NULL_HANDLE, "Buffer memory is VK_NULL_HANDLE.");
+    MLC_ASSERT(buffer.m_allocation.memory != VK_NULL_HANDLE, "Buffer memory is VK_NULL_HANDLE.");
 
-    vkDestroyBuffer(m_device, buffer.m_handle, MLC_VULKAN_ALLOCATOR);
+    m_deletionQueue.Push(m_frameCount, [this, handle = buffer.m_handle, allocation = buffer.m_allocation]() mutable {
+        vkDestroyBuffer(m_device, handle, MLC_VULKAN_ALLOCATOR);
+        m_memoryAllocator.Free(allocation);
+    });
     buffer.m_handle = VK_NULL_HANDLE;
-    vkFreeMemory(m_device, buffer.m_memory, MLC_VULKAN_ALLOCATOR);
-    buffer.m_memory = VK_NULL_HANDLE;
+    buffer.m_allocation = DeviceAllocation {};
+    buffer.m_size = 0;
 }
 
 void VulkanManager::UploadBuffer(const GPUBuffer& buffer, const void* data, size_t size) const
 {
-    void* mappedRegion;
-    vkMapMemory(m_device, buffer.m_memory, 0, size, 0, &mappedRegion);
-    memcpy(mappedRegion, data, size);
-    vkUnmapMemory(m_device, buffer.m_memory);
+    MLC_ASSERT(buffer.m_allocation.mappedData != nullptr, "Buffer memory is not host visible.");
+    MLC_ASSERT(size <= buffer.m_size, "Upload is bigger than the buffer.");
+
+    // Blocks are persistently mapped, no need to map/unmap every upload
+    memcpy(buffer.m_allocation.mappedData, data, size);
 }
 
 void VulkanManager::CopyBuffer(const GPUBuffer& src, const GPUBuffer& dst, VkDeviceSize size) const
@@ -284,6 +491,33 @@ void VulkanManager::CopyBuffer(const GPUBuffer& src, const GPUBuffer& dst, VkDev
     _EndSingleUseCommands(copyCmdBuffer, m_transferCmdPool);
 }
 
+UploadTicket VulkanManager::UploadBufferAsync(const GPUBuffer& dst,
+                                             const void* data,
+                                             VkDeviceSize size,
+                                             VkDeviceSize dst_offset) const
+{
+    UploadBatch batch;
+    QueueBufferUpload(batch, dst, data, size, dst_offset);
+    return SubmitUploadBatch(batch);
+}
+
+uint32_t VulkanManager::PushUniformData(const void* data, VkDeviceSize size) const
+{
+    MLC_ASSERT(size <= m_uniformRingRange, "Uniform data is bigger than the uniform ring binding's range.");
+
+    VkDeviceSize offset = (m_uniformRingHead + m_uniformRingAlignment - 1) / m_uniformRingAlignment * m_uniformRingAlignment;
+    // The descriptor always reads a whole range, even if less was pushed
+    MLC_ASSERT(offset + m_uniformRingRange <= UNIFORM_RING_SIZE_PER_FRAME,
+               "Uniform ring is full, raise UNIFORM_RING_SIZE_PER_FRAME.");
+    m_uniformRingHead = offset + size;
+
+    char* frameData = static_cast<char*>(m_uniformRingBuffer.m_allocation.mappedData) +
+                      m_currentFrameIndex * UNIFORM_RING_SIZE_PER_FRAME;
+    memcpy(frameData + offset, data, size);
+
+    return static_cast<uint32_t>(offset);
+}
+
 void* VulkanManager::GetBufferMapping(const GPUBuffer& buffer,
                                       VkDeviceSize offset,
                                       VkDeviceSize size) const
@@ -293,10 +527,53 @@ void* VulkanManager::GetBufferMapping(const GPUBuffer& buffer,
     MLC_ASSERT((buffer.m_properties & mandatoryMemoryProperties) == mandatoryMemoryProperties,
                "Failed to get buffer mapping due to invalid buffer's memory properties.");
 
-    void* mappedMemory;
-    vkMapMemory(m_device, buffer.m_memory, offset, size, 0, &mappedMemory);
+    MLC_ASSERT(offset + size <= buffer.m_size, "Buffer mapping is out of bounds.");
+
+    return static_cast<char*>(buffer.m_allocation.mappedData) + offset;
+}
+
+GeometryRange VulkanManager::AllocateGeometry(uint32_t vertex_count, uint32_t index_count) const
+{
+    uint64_t firstVertex = m_geometryVertexRanges.Allocate(vertex_count);
+    uint64_t firstIndex = m_geometryIndexRanges.Allocate(index_count);
+    MLC_ASSERT(firstVertex != FreeListAllocator::INVALID_OFFSET && firstIndex != FreeListAllocator::INVALID_OFFSET,
+               "Geometry arena is full, raise GEOMETRY_ARENA_VERTEX_CAPACITY/GEOMETRY_ARENA_INDEX_CAPACITY.");
+
+    return GeometryRange {
+        .firstVertex = static_cast<uint32_t>(firstVertex),
+        .vertexCount = vertex_count,
+        .firstIndex = static_cast<uint32_t>(firstIndex),
+        .indexCount = index_count
+    };
+}
+
+void VulkanManager::DeallocateGeometry(GeometryRange& range) const
+{
+    MLC_ASSERT(range.vertexCount > 0 && range.indexCount > 0, "Geometry range is empty.");
+
+    // Frames in flight may still draw from it
+    m_deletionQueue.Push(m_frameCount, [this, range]() {
+        m_geometryVertexRanges.Free(range.firstVertex, range.vertexCount);
+        m_geometryIndexRanges.Free(range.firstIndex, range.indexCount);
+    });
+    range = GeometryRange {};
+}
 
-    return mappedMemory;
+void VulkanManager::QueueGeometryUpload(UploadBatch& batch,
+                                        const GeometryRange& range,
+                                        const void* vertices,
+                                        const void* indices) const
+{
+    QueueBufferUpload(batch,
+                      m_geometryVertexBuffer,
+                      vertices,
+                      sizeof(Vertex) * range.vertexCount,
+                      sizeof(Vertex) * range.firstVertex);
+    QueueBufferUpload(batch,
+                      m_geometryIndexBuffer,
+                      indices,
+                      sizeof(uint16_t) * range.indexCount,
+                      sizeof(uint16_t) * range.firstIndex);
 }
 
 void VulkanManager::AllocateImage2D(GPUImage& image,
@@ -304,8 +581,16 @@ void VulkanManager::AllocateImage2D(GPUImage& image,
                                     int height,
                                     VkFormat format,
                                     VkImageUsageFlags usage,
-                                    VkMemoryPropertyFlags properties) const
+                                    VkMemoryPropertyFlags properties,
+                                    uint32_t mip_levels) const
 {
+    // Uploads write and transition images on the transfer queue, without ownership transfers
+    std::array<uint32_t, 2> queueFamilies {
+        m_queueFamilyIndices.graphicsFamily.value(),
+        m_queueFamilyIndices.transferFamily.value()
+    };
+    bool concurrent = queueFamilies[0] != queueFamilies[1];
+
     VkImageCreateInfo imageCreateInfo {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
@@ -317,14 +602,14 @@ void VulkanManager::AllocateImage2D(GPUImage& image,
             .height = static_cast<uint32_t>(height),
             .depth = 1
         },
-        .mipLevels = 1,
+        .mipLevels = mip_levels,
         .arrayLayers = 1,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
         .usage = usage,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,  // only used by graphics family
-        .queueFamilyIndexCount = 1,
-        .pQueueFamilyIndices = &m_queueFamilyIndices.graphicsFamily.value(),
+        .sharingMode = concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = concurrent ? static_cast<uint32_t>(queueFamilies.size()) : 0,
+        .pQueueFamilyIndices = concurrent ? queueFamilies.data() : nullptr,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
     };
 
@@ -334,28 +619,25 @@ void VulkanManager::AllocateImage2D(GPUImage& image,
     VkMemoryRequirements memoryRequirements;
     vkGetImageMemoryRequirements(m_device, image.m_handle, &memoryRequirements);
 
-    VkMemoryAllocateInfo allocInfo {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .allocationSize = memoryRequirements.size,
-        .memoryTypeIndex = _FindMemoryType(memoryRequirements.memoryTypeBits, properties)
-    };
+    image.m_allocation = m_memoryAllocator.Allocate(memoryRequirements, properties, DeviceResourceKind::OPTIMAL);
 
-    result = vkAllocateMemory(m_device, &allocInfo, MLC_VULKAN_ALLOCATOR, &image.m_memory);
-    MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate image memory (2D).");
+    result = vkBindImageMemory(m_device, image.m_handle, image.m_allocation.memory, image.m_allocation.offset);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to bind image memory (2D).");
 
-    vkBindImageMemory(m_device, image.m_handle, image.m_memory, 0);
+    image.m_properties = properties;
 }
 
 void VulkanManager::DeallocateImage2D(GPUImage& image) const
 {
     MLC_ASSERT(image.m_handle != VK_NULL_HANDLE, "Image handle is VK_NULL_HANDLE.");
-    MLC_ASSERT(image.m_memory != VK_NULL_HANDLE, "Image memory is VK_NULL_HANDLE.");
+    MLC_ASSERT(image.m_allocation.memory != VK_NULL_HANDLE, "Image memory is VK_NULL_HANDLE.");
 
-    vkDestroyImage(m_device, image.m_handle, MLC_VULKAN_ALLOCATOR);
+    m_deletionQueue.Push(m_frameCount, [this, handle = image.m_handle, allocation = image.m_allocation]() mutable {
+        vkDestroyImage(m_device, handle, MLC_VULKAN_ALLOCATOR);
+        m_memoryAllocator.Free(allocation);
+    });
     image.m_handle = VK_NULL_HANDLE;
-    vkFreeMemory(m_device, image.m_memory, MLC_VULKAN_ALLOCATOR);
-    image.m_memory = VK_NULL_HANDLE;
+    image.m_allocation = DeviceAllocation {};
 }
 
 void VulkanManager::TransitionImageLayout(const GPUImage& image,
@@ -438,30 +720,222 @@ void VulkanManager::CopyBufferToImage(const GPUBuffer& src,
                                       uint32_t height) const
 {
     VkCommandBuffer copyCmdBuffer = _BeginSingleUseCommands(m_transferCmdPool);
-    VkBufferImageCopy region {
-        .bufferOffset = 0,
-        .bufferRowLength = 0,
-        .bufferImageHeight = 0,
-        .imageSubresource = VkImageSubresourceLayers {
+    _RecordCopyBufferToImage(copyCmdBuffer, src.m_handle, 0, dst.m_handle, width, height);
+    _EndSingleUseCommands(copyCmdBuffer, m_transferCmdPool);
+}
+
+UploadTicket VulkanManager::UploadImage2DAsync(const GPUImage& dst,
+                                              const void* pixels,
+                                              VkDeviceSize size,
+                                              uint32_t width,
+                                              uint32_t height) const
+{
+    UploadBatch batch;
+    QueueImage2DUpload(batch, dst, pixels, size, width, height);
+    return SubmitUploadBatch(batch);
+}
+
+void VulkanManager::QueueBufferUpload(UploadBatch& batch,
+                                      const GPUBuffer& dst,
+                                      const void* data,
+                                      VkDeviceSize size,
+                                      VkDeviceSize dst_offset) const
+{
+    MLC_ASSERT(dst_offset + size <= dst.m_size, "Upload is bigger than the buffer.");
+
+    StagingAllocation staging = _AllocateStaging(batch, size);
+    memcpy(staging.mappedData, data, size);
+
+    batch.m_bufferCopies.push_back(UploadBatch::BufferCopy {
+        .src = staging.buffer,
+        .dst = dst.m_handle,
+        .region = VkBufferCopy {
+            .srcOffset = staging.offset,
+            .dstOffset = dst_offset,
+            .size = size
+        }
+    });
+}
+
+void VulkanManager::QueueBufferRewrite(UploadBatch& batch,
+                                       const GPUBuffer& dst,
+                                       const void* data,
+                                       VkDeviceSize size,
+                                       VkDeviceSize dst_offset) const
+{
+    QueueBufferUpload(batch, dst, data, size, dst_offset);
+    batch.m_waitsForFrames = true;
+}
+
+void VulkanManager::QueueImage2DUpload(UploadBatch& batch,
+                                       const GPUImage& dst,
+                                       const void* pixels,
+                                       VkDeviceSize size,
+                                       uint32_t width,
+                                       uint32_t height) const
+{
+    StagingAllocation staging = _AllocateStaging(batch, size);
+    memcpy(staging.mappedData, pixels, size);
+
+    QueueImageTransition(batch, dst, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    batch.m_imageCopies.push_back(UploadBatch::ImageCopy {
+        .src = staging.buffer,
+        .srcOffset = staging.offset,
+        .dst = dst.m_handle,
+        .width = width,
+        .height = height
+    });
+    QueueImageTransition(batch, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void VulkanManager::QueueImageTransition(UploadBatch& batch,
+                                         const GPUImage& image,
+                                         VkImageLayout old_layout,
+                                         VkImageLayout new_layout) const
+{
+    MLC_ASSERT(old_layout == VK_IMAGE_LAYOUT_UNDEFINED || old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               "Unsupported layout transition in upload batch.");
+
+    // The transfer queue can't name later stages or their access flags, the frame's
+    // wait on the upload timeline makes the writes visible to the shaders
+    VkImageMemoryBarrier imageBarrier {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = VK_NULL_HANDLE,
+        .srcAccessMask = old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ? VK_ACCESS_TRANSFER_WRITE_BIT : 0u,
+        .dstAccessMask = new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ? VK_ACCESS_TRANSFER_WRITE_BIT : 0u,
+        .oldLayout = old_layout,
+        .newLayout = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image.m_handle,
+        .subresourceRange = VkImageSubresourceRange {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-            .mipLevel = 0,
+            .baseMipLevel = 0,
+            .levelCount = 1,
             .baseArrayLayer = 0,
             .layerCount = 1
-        },
-        .imageOffset = { 0, 0, 0 },
-        .imageExtent = VkExtent3D {
-            .width = width,
-            .height = height,
-            .depth = 1
         }
     };
-    vkCmdCopyBufferToImage(copyCmdBuffer,
-                           src.m_handle,
-                           dst.m_handle,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1,
-                           &region);
-    _EndSingleUseCommands(copyCmdBuffer, m_transferCmdPool);
+
+    if (new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+    {
+        batch.m_preCopyBarriers.push_back(imageBarrier);
+    }
+    else
+    {
+        batch.m_postCopyBarriers.push_back(imageBarrier);
+    }
+}
+
+UploadTicket VulkanManager::SubmitUploadBatch(UploadBatch& batch) const
+{
+    if (batch.m_holdsStaging)
+    {
+        m_openUploadBatches--;
+        batch.m_holdsStaging = false;
+    }
+    if (batch.IsEmpty())
+    {
+        return UploadTicket {};
+    }
+
+    if (batch.m_waitsForFrames)
+    {
+        // The transfer queue doesn't wait for the graphics queue, frames presented afterwards wait for the copy
+        vkWaitForFences(m_device,
+                        static_cast<uint32_t>(m_inFlightFences.size()),
+                        m_inFlightFences.data(),
+                        VK_TRUE,
+                        UINT64_MAX);
+        batch.m_waitsForFrames = false;
+    }
+
+    VkCommandBuffer copyCmdBuffer = _BeginSingleUseCommands(m_transferCmdPool);
+
+    if (!batch.m_preCopyBarriers.empty())
+    {
+        vkCmdPipelineBarrier(copyCmdBuffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             static_cast<uint32_t>(batch.m_preCopyBarriers.size()),
+                             batch.m_preCopyBarriers.data());
+    }
+
+    // Consecutive copies between the same pair of buffers go out as one command
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < batch.m_bufferCopies.size(); i++)
+    {
+        const UploadBatch::BufferCopy& copy = batch.m_bufferCopies[i];
+        regions.push_back(copy.region);
+
+        bool lastOfRun = i + 1 == batch.m_bufferCopies.size() ||
+                         batch.m_bufferCopies[i + 1].src != copy.src ||
+                         batch.m_bufferCopies[i + 1].dst != copy.dst;
+        if (lastOfRun)
+        {
+            vkCmdCopyBuffer(copyCmdBuffer,
+                            copy.src,
+                            copy.dst,
+                            static_cast<uint32_t>(regions.size()),
+                            regions.data());
+            regions.clear();
+        }
+    }
+
+    for (const UploadBatch::ImageCopy& copy : batch.m_imageCopies)
+    {
+        _RecordCopyBufferToImage(copyCmdBuffer, copy.src, copy.srcOffset, copy.dst, copy.width, copy.height);
+    }
+
+    if (!batch.m_postCopyBarriers.empty())
+    {
+        vkCmdPipelineBarrier(copyCmdBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             static_cast<uint32_t>(batch.m_postCopyBarriers.size()),
+                             batch.m_postCopyBarriers.data());
+    }
+
+    UploadTicket ticket = _SubmitUpload(copyCmdBuffer);
+
+    for (GPUBuffer& buffer : batch.m_overflowBuffers)
+    {
+        m_stagingOverflowBuffers.emplace_back(ticket.value, std::move(buffer));
+    }
+    batch.m_overflowBuffers.clear();
+    batch.m_preCopyBarriers.clear();
+    batch.m_bufferCopies.clear();
+    batch.m_imageCopies.clear();
+    batch.m_postCopyBarriers.clear();
+
+    return ticket;
+}
+
+bool VulkanManager::IsUploadComplete(UploadTicket ticket) const
+{
+    uint64_t completedValue;
+    vkGetSemaphoreCounterValue(m_device, m_uploadTimeline, &completedValue);
+    return completedValue >= ticket.value;
+}
+
+void VulkanManager::WaitUpload(UploadTicket ticket) const
+{
+    VkSemaphoreWaitInfo waitInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .semaphoreCount = 1,
+        .pSemaphores = &m_uploadTimeline,
+        .pValues = &ticket.value
+    };
+    VkResult result = vkWaitSemaphores(m_device, &waitInfo, UINT64_MAX);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to wait for upload.");
+
+    _ReclaimUploads();
 }
 
 void VulkanManager::CreateImage2DViewer(Image2DViewer& viewer, const GPUImage& image, VkFormat format) const
@@ -495,6 +969,19 @@ void VulkanManager::CreateImage2DViewer(Image2DViewer& viewer, const GPUImage& i
 
     VkResult result = vkCreateSampler(m_device, &samplerCreateInfo, MLC_VULKAN_ALLOCATOR, &viewer.m_sampler);
     MLC_ASSERT(result == VK_SUCCESS, "Failed to create sampler.");
+
+    if (!m_freeBindlessTextures.empty())
+    {
+        viewer.m_bindlessIndex = m_freeBindlessTextures.back();
+        m_freeBindlessTextures.pop_back();
+    }
+    else
+    {
+        MLC_ASSERT(m_bindlessTextureCount < m_bindlessTextureCapacity,
+                   "Bindless texture table is full, raise MAX_BINDLESS_TEXTURES.");
+        viewer.m_bindlessIndex = m_bindlessTextureCount++;
+    }
+    _WriteBindlessTexture(viewer.m_bindlessIndex, viewer);
 }
 
 void VulkanManager::DestroyImage2DViewer(Image2DViewer& viewer) const
@@ -502,9 +989,16 @@ void VulkanManager::DestroyImage2DViewer(Image2DViewer& viewer) const
     MLC_ASSERT(viewer.m_imageView != VK_NULL_HANDLE, "Image2DViewer ImageView is VK_NULL_HANDLE.");
     MLC_ASSERT(viewer.m_sampler != VK_NULL_HANDLE, "Image2DViewer Sampler is VK_NULL_HANDLE.");
 
-    vkDestroyImageView(m_device, viewer.m_imageView, MLC_VULKAN_ALLOCATOR);
+    // The slot is reused only once frames that might sample it are done
+    m_deletionQueue.Push(m_frameCount, [this,
+                                        imageView = viewer.m_imageView,
+                                        sampler = viewer.m_sampler,
+                                        bindlessIndex = viewer.m_bindlessIndex]() {
+        vkDestroyImageView(m_device, imageView, MLC_VULKAN_ALLOCATOR);
+        vkDestroySampler(m_device, sampler, MLC_VULKAN_ALLOCATOR);
+        m_freeBindlessTextures.push_back(bindlessIndex);
+    });
     viewer.m_imageView = VK_NULL_HANDLE;
-    vkDestroySampler(m_device, viewer.m_sampler, MLC_VULKAN_ALLOCATOR);
     viewer.m_sampler = VK_NULL_HANDLE;
 }
 
@@ -526,7 +1020,9 @@ void VulkanManager::CreateShaderModule(VkShaderModule& shader_module, const std:
 
 void VulkanManager::DestroyShaderModule(VkShaderModule& shader_module) const
 {
-    vkDestroyShaderModule(m_device, shader_module, MLC_VULKAN_ALLOCATOR);
+    m_deletionQueue.Push(m_frameCount, [this, shader_module]() {
+        vkDestroyShaderModule(m_device, shader_module, MLC_VULKAN_ALLOCATOR);
+    });
     shader_module = VK_NULL_HANDLE;
 }
 
@@ -557,50 +1053,35 @@ void VulkanManager::DestroyFences(VkFence* fences, uint32_t amount) const
 
 void VulkanManager::CreateDescriptorPool(const std::vector<DescriptorInfo>& descriptor_infos)
 {
-    std::vector<VkDescriptorPoolSize> poolSizes;
-    poolSizes.resize(descriptor_infos.size());
-    for (uint32_t i = 0; i < descriptor_infos.size(); i++)  // number of descriptor types
+    // What one set needs, the allocator scales it up to however many sets a pool holds
+    std::vector<VkDescriptorPoolSize> sizesPerSet;
+    sizesPerSet.resize(descriptor_infos.size());
+    for (uint32_t i = 0; i < descriptor_infos.size(); i++)
     {
-        uint32_t descriptorTypeMaxCount;
-        switch (descriptor_infos[i].type)
-        {
-            case DescriptorTypes::UNIFORM_BUFFER:
-                descriptorTypeMaxCount = MAX_DESCRIPTOR_PER_SET_UNIFORM_BUFFER;
-                break;
-            case DescriptorTypes::COMBINED_IMAGE_SAMPLER:
-                descriptorTypeMaxCount = MAX_DESCRIPTOR_PER_SET_COMBINED_SAMPLER;
-                break;
-            default:
-                MLC_ERROR("Unknown descriptor type.");
-                break;
-        }
-        poolSizes[i] = VkDescriptorPoolSize {
+        sizesPerSet[i] = VkDescriptorPoolSize {
             .type = static_cast<VkDescriptorType>(descriptor_infos[i].type),
-            .descriptorCount = MAX_DESCRIPTOR_SETS * descriptorTypeMaxCount
+            .descriptorCount = descriptor_infos[i].count
         };
     }
-    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .flags = 0,
-        .maxSets = MAX_DESCRIPTOR_SETS,
-        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
-        .pPoolSizes = poolSizes.data()
-    };
-    // vkResetDescriptorPool(VkDevice device, VkDescriptorPool descriptorPool, VkDescriptorPoolResetFlags flags)
-    VkResult result = vkCreateDescriptorPool(m_device,
-                                             &descriptorPoolCreateInfo,
-                                             MLC_VULKAN_ALLOCATOR,
-                                             &m_descriptorPool);
-    MLC_ASSERT(result == VK_SUCCESS, "Failed to creat descriptor pool.");
+
+    m_descriptorAllocator.Init(m_device, sizesPerSet);
 }
 
 void VulkanManager::CreateDescriptorSetLayout(const std::vector<DescriptorInfo>& descriptor_infos)
 {
     std::vector<VkDescriptorSetLayoutBinding> bindings;
     bindings.resize(descriptor_infos.size());
+    m_hasUniformRingBinding = false;
     for (uint32_t i = 0; i < descriptor_infos.size(); i++)
     {
+        if (descriptor_infos[i].type == DescriptorTypes::UNIFORM_BUFFER_DYNAMIC)
+        {
+            // Draws only pass one dynamic offset
+            MLC_ASSERT(!m_hasUniformRingBinding && descriptor_infos[i].count == 1,
+                       "Only one UNIFORM_BUFFER_DYNAMIC descriptor is supported.");
+            m_hasUniformRingBinding = true;
+        }
+
         bindings[i] = VkDescriptorSetLayoutBinding {
             .binding = descriptor_infos[i].binding,
             .descriptorType = static_cast<VkDescriptorType>(descriptor_infos[i].type),
@@ -610,106 +1091,179 @@ void VulkanManager::CreateDescriptorSetLayout(const std::vector<DescriptorInfo>&
         };
     }
 
-    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .flags = 0,
-        .bindingCount = static_cast<uint32_t>(bindings.size()),
-        .pBindings = bindings.data()
-    };
-
-    VkResult result = vkCreateDescriptorSetLayout(m_device,
-                                                  &descriptorSetLayoutCreateInfo,
-                                                  MLC_VULKAN_ALLOCATOR,
-                                                  &m_descriptorSetLayout);
-    MLC_ASSERT(result == VK_SUCCESS, "Failed to create descriptor set layout.");
+    m_descriptorSetLayout = m_descriptorSetLayoutCache.GetLayout(bindings);
 }
 
 void VulkanManager::CreateDescriptorSets()
 {
-    std::array<VkDescriptorSetLayout, MAX_DESCRIPTOR_SETS> layouts;
-    layouts.fill(m_descriptorSetLayout);
-    VkDescriptorSetAllocateInfo allocateInfo {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .descriptorPool = m_descriptorPool,
-        .descriptorSetCount = MAX_DESCRIPTOR_SETS,
-        .pSetLayouts = layouts.data()
-    };
-
-    vkAllocateDescriptorSets(m_device, &allocateInfo, m_descriptorSets.data());
+    for (VkDescriptorSet& descriptorSet : m_descriptorSets)
+    {
+        descriptorSet = m_descriptorAllocator.Allocate(m_descriptorSetLayout);
+    }
+    m_drawStateEpoch++;
 }
 
-void VulkanManager::DescriptorSetBindUBO(const std::array<GPUBuffer, MAX_DESCRIPTOR_SETS>& ubo_buffers,
-                                         VkDeviceSize offset,
-                                         VkDeviceSize size_per_buffer) const
+void VulkanManager::DescriptorSetBindUniformRing(uint32_t binding, VkDeviceSize range)
 {
+    MLC_ASSERT(range > 0 && range <= UNIFORM_RING_SIZE_PER_FRAME, "Invalid uniform ring range.");
+    m_uniformRingRange = range;
+    m_uniformRingBinding = binding;
+
     for (uint32_t i = 0; i < MAX_DESCRIPTOR_SETS; i++)
     {
-        VkDescriptorBufferInfo bufferInfo {
-            .buffer = ubo_buffers[i].m_handle,
-            .offset = offset,
-            .range = size_per_buffer
-        };
-        VkWriteDescriptorSet descriptorWrite {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .pNext = VK_NULL_HANDLE,
-            .dstSet = m_descriptorSets[i],
-            .dstBinding = 0,
-            .dstArrayElement = 0,  // It is possible to update multiple descriptors at once in an array
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-            .pImageInfo = VK_NULL_HANDLE,
-            .pBufferInfo = &bufferInfo,
-            .pTexelBufferView = VK_NULL_HANDLE
-        };
-        
-        vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+        _WriteUniformRingDescriptor(m_descriptorSets[i], i);
     }
+    m_drawStateEpoch++;
 }
 
-void VulkanManager::DescriptorSetBindImage2D(const Image2DViewer& viewer) const
+const GraphicsPipeline* VulkanManager::GetGraphicsPipeline(const PipelineResources& pipeline_config)
 {
-    for (uint32_t i = 0; i < MAX_DESCRIPTOR_SETS; i++)
+    auto [it, inserted] = m_graphicsPipelines.try_emplace(_GetGraphicsPipelineKey(pipeline_config));
+    if (inserted)
     {
-        VkDescriptorImageInfo imageInfo {
-            .sampler = viewer.m_sampler,
-            .imageView = viewer.m_imageView,
-            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
-        };
-        VkWriteDescriptorSet descriptorWrite {
-            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-            .pNext = VK_NULL_HANDLE,
-            .dstSet = m_descriptorSets[i],
-            .dstBinding = 1,
-            .dstArrayElement = 0,  // It is possible to update multiple descriptors at once in an array
-            .descriptorCount = 1,
-            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-            .pImageInfo = &imageInfo,
-            .pBufferInfo = VK_NULL_HANDLE,
-            .pTexelBufferView = VK_NULL_HANDLE
-        };
-
-        vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+        // The worker gets its own copy of the key, the node stays where it is until
+        // DestroyGraphicsPipelines() waits for this
+        m_pipelineCompileThreads.Push([this, key = it->first, &pipeline = it->second]() {
+            _CreateGraphicsPipeline(key, pipeline);
+        });
     }
+    return &it->second;
 }
 
-void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_config)
+void VulkanManager::WaitForGraphicsPipelines()
 {
-    // ----- Programmable stages of the pipeline -----
-    
-    m_pipelineConfig = pipeline_config;
+    m_pipelineCompileThreads.WaitIdle();
+}
 
-    const Shader* shader = pipeline_config.material.GetShader();
+void VulkanManager::SetDefaultGraphicsPipeline(const GraphicsPipeline* pipeline)
+{
+    m_defaultPipeline = pipeline;
+    m_drawStateEpoch++;
+}
 
-    VkPipelineShaderStageCreateInfo vertShaderStageCreateInfo {
-        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .flags = 0,
-        .stage = VK_SHADER_STAGE_VERTEX_BIT,
-        .module = shader->m_vertShaderModule,
-        .pName = "main",
-        .pSpecializationInfo = nullptr  // this can specify constants inside the shader
+void VulkanManager::SetFallbackGraphicsPipeline(const GraphicsPipeline* pipeline)
+{
+    m_fallbackPipeline = pipeline;
+    m_drawStateEpoch++;
+}
+
+void VulkanManager::DestroyGraphicsPipelines()
+{
+    // Compiles write into the map's nodes
+    m_pipelineCompileThreads.WaitIdle();
+
+    // Frames in flight were recorded with them. Ones dropped by a stopped TaskQueue are VK_NULL_HANDLE.
+    for (auto& [key, pipeline] : m_graphicsPipelines)
+    {
+        m_deletionQueue.Push(m_frameCount, [this, handle = pipeline.m_pipeline, layout = pipeline.m_layout]() {
+            vkDestroyPipeline(m_device, handle, MLC_VULKAN_ALLOCATOR);
+            vkDestroyPipelineLayout(m_device, layout, MLC_VULKAN_ALLOCATOR);
+        });
+    }
+    m_graphicsPipelines.clear();
+    m_defaultPipeline = nullptr;
+    m_fallbackPipeline = nullptr;
+    m_drawStateEpoch++;
+}
+
+bool VulkanManager::GraphicsPipelineKey::operator==(const GraphicsPipelineKey& other) const
+{
+    return vertShaderModule == other.vertShaderModule &&
+           fragShaderModule == other.fragShaderModule &&
+           SameBytes(vertexInputBindingDescs, other.vertexInputBindingDescs) &&
+           SameBytes(vertexInputAttribDescs, other.vertexInputAttribDescs) &&
+           pushConstantSize == other.pushConstantSize &&
+           pushConstantStages == other.pushConstantStages &&
+           cullMode == other.cullMode &&
+           frontFace == other.frontFace &&
+           depthTest == other.depthTest &&
+           depthWrite == other.depthWrite &&
+           depthCompareOp == other.depthCompareOp &&
+           alphaBlending == other.alphaBlending &&
+           descriptorSetLayout == other.descriptorSetLayout &&
+           bindlessTextureLayout == other.bindlessTextureLayout &&
+           renderPass == other.renderPass &&
+           colorFormat == other.colorFormat &&
+           depthFormat == other.depthFormat;
+}
+
+size_t VulkanManager::GraphicsPipelineKeyHash::operator()(const GraphicsPipelineKey& key) const
+{
+    uint64_t hash = 0;
+    HashCombine(hash, reinterpret_cast<uint64_t>(key.vertShaderModule));
+    HashCombine(hash, reinterpret_cast<uint64_t>(key.fragShaderModule));
+    HashCombine(hash, key.vertexInputBindingDescs.size());
+    HashBytes(hash,
+              key.vertexInputBindingDescs.data(),
+              sizeof(VkVertexInputBindingDescription) * key.vertexInputBindingDescs.size());
+    HashCombine(hash, key.vertexInputAttribDescs.size());
+    HashBytes(hash,
+              key.vertexInputAttribDescs.data(),
+              sizeof(VkVertexInputAttributeDescription) * key.vertexInputAttribDescs.size());
+    HashCombine(hash, key.pushConstantSize);
+    HashCombine(hash, key.pushConstantStages);
+    HashCombine(hash, key.cullMode);
+    HashCombine(hash, key.frontFace);
+    HashCombine(hash, key.depthTest);
+    HashCombine(hash, key.depthWrite);
+    HashCombine(hash, key.depthCompareOp);
+    HashCombine(hash, key.alphaBlending);
+    HashCombine(hash, reinterpret_cast<uint64_t>(key.descriptorSetLayout));
+    HashCombine(hash, reinterpret_cast<uint64_t>(key.bindlessTextureLayout));
+    HashCombine(hash, reinterpret_cast<uint64_t>(key.renderPass));
+    HashCombine(hash, key.colorFormat);
+    HashCombine(hash, key.depthFormat);
+    return static_cast<size_t>(hash);
+}
+
+VulkanManager::GraphicsPipelineKey VulkanManager::_GetGraphicsPipelineKey(const PipelineResources& pipeline_config) const
+{
+    // The albedo isn't part of the pipeline
+    const Shader* shader = pipeline_config.material.GetShader();
+    GraphicsPipelineKey key {
+        .vertShaderModule = shader->m_vertShaderModule,
+        .fragShaderModule = shader->m_fragShaderModule,
+        .vertexInputBindingDescs = {},
+        .vertexInputAttribDescs = {},
+        .pushConstantSize = pipeline_config.pushConstantSize,
+        .pushConstantStages = pipeline_config.pushConstantStages,
+        .cullMode = pipeline_config.cullMode,
+        .frontFace = pipeline_config.frontFace,
+        .depthTest = pipeline_config.depthTest,
+        .depthWrite = pipeline_config.depthWrite,
+        .depthCompareOp = pipeline_config.depthCompareOp,
+        .alphaBlending = pipeline_config.alphaBlending,
+        .descriptorSetLayout = m_descriptorSetLayout,
+        .bindlessTextureLayout = m_bindlessTextureLayout,
+        .renderPass = m_renderPass,
+        .colorFormat = m_dynamicRendering ? m_swapChainImageFormat : VK_FORMAT_UNDEFINED,
+        .depthFormat = m_dynamicRendering ? _FindDepthFormat() : VK_FORMAT_UNDEFINED
+    };
+    if (!m_vertexInputDynamicStateSupported)
+    {
+        // Otherwise one pipeline serves every vertex layout
+        key.vertexInputBindingDescs = pipeline_config.vertexInputBindingDescs;
+        key.vertexInputAttribDescs = pipeline_config.vertexInputAttribDescs;
+    }
+    return key;
+}
+
+void VulkanManager::_CreateGraphicsPipeline(const GraphicsPipelineKey& key, GraphicsPipeline& pipeline) const
+{
+    // Runs on a compile thread. Besides `key` it only reads what's fixed after Init, so the main
+    // thread can change descriptor set layouts or the swap chain meanwhile. Pipeline creation and
+    // the pipeline cache are thread safe, the main thread only reads `pipeline` once it's ready.
+
+    // ----- Programmable stages of the pipeline -----
+
+    VkPipelineShaderStageCreateInfo vertShaderStageCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .stage = VK_SHADER_STAGE_VERTEX_BIT,
+        .module = key.vertShaderModule,
+        .pName = "main",
+        .pSpecializationInfo = nullptr  // this can specify constants inside the shader
     };
 
     VkPipelineShaderStageCreateInfo fragShaderStageCreateInfo {
@@ -717,7 +1271,7 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
         .pNext = VK_NULL_HANDLE,
         .flags = 0,
         .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-        .module = shader->m_fragShaderModule,
+        .module = key.fragShaderModule,
         .pName = "main",
         .pSpecializationInfo = nullptr  // this can specify constants inside the shader
     };
@@ -730,17 +1284,17 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
     // ----- Fixed stages -----
 
     // Dynamic states
-    std::array<VkDynamicState, 2> dynamicStates = {
+    std::array<VkDynamicState, 3> dynamicStates = {
         VK_DYNAMIC_STATE_VIEWPORT,
         VK_DYNAMIC_STATE_SCISSOR,
-        // VK_DYNAMIC_STATE_VERTEX_INPUT_EXT
+        VK_DYNAMIC_STATE_VERTEX_INPUT_EXT  // dropped without the feature
     };
 
     VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
         .flags = 0,
-        .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()),
+        .dynamicStateCount = static_cast<uint32_t>(dynamicStates.size()) - (m_vertexInputDynamicStateSupported ? 0 : 1),
         .pDynamicStates = dynamicStates.data()
     };
 
@@ -752,12 +1306,11 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
         .scissorCount = 1
     };
 
-    // Vertex input
-    // TODO
+    // Vertex input, only used when it isn't set per draw with vkCmdSetVertexInputEXT
     std::vector<VkVertexInputBindingDescription> bindingDescs =
-        pipeline_config.vertexInputBindingDescs;
+        key.vertexInputBindingDescs;
     std::vector<VkVertexInputAttributeDescription> attribDescs =
-        pipeline_config.vertexInputAttribDescs;
+        key.vertexInputAttribDescs;
     VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
@@ -785,8 +1338,8 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
         .depthClampEnable = VK_FALSE,  // VK_TRUE might be useful for shadow maps
         .rasterizerDiscardEnable = VK_FALSE,
         .polygonMode = VK_POLYGON_MODE_FILL,
-        .cullMode = VK_CULL_MODE_BACK_BIT,
-        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .cullMode = key.cullMode,
+        .frontFace = key.frontFace,
         .depthBiasEnable = VK_FALSE,  // depth bias may be useful for shadow maps
         .depthBiasConstantFactor = 0.0f,
         .depthBiasClamp = 0.0f,
@@ -812,9 +1365,9 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
         .flags = 0,
-        .depthTestEnable = VK_TRUE,
-        .depthWriteEnable = VK_TRUE,
-        .depthCompareOp = VK_COMPARE_OP_LESS,
+        .depthTestEnable = key.depthTest ? VK_TRUE : VK_FALSE,
+        .depthWriteEnable = key.depthWrite ? VK_TRUE : VK_FALSE,
+        .depthCompareOp = key.depthCompareOp,
         .depthBoundsTestEnable = VK_FALSE,  // depth testing but in a range instead of compareOp
         .stencilTestEnable = VK_FALSE,  // TODO: Later,
         .front = {},
@@ -823,9 +1376,9 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
         .maxDepthBounds = 1.0f,
     };
 
-    // Color blending (// TODO)
+    // Color blending
     VkPipelineColorBlendAttachmentState colorBlendAttachment {
-        .blendEnable = VK_TRUE,
+        .blendEnable = key.alphaBlending ? VK_TRUE : VK_FALSE,
         .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
         .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
         .colorBlendOp = VK_BLEND_OP_ADD,
@@ -850,29 +1403,51 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
 
     // ----- Pipeline Layout -----
 
-    std::array<VkDescriptorSetLayout, 2> layouts = { m_descriptorSetLayout, m_descriptorSetLayout };
+    // Frames in flight each get their own set 0, but only one is bound at a time
+    std::array<VkDescriptorSetLayout, 2> layouts = { key.descriptorSetLayout, key.bindlessTextureLayout };
+    static_assert(BINDLESS_TEXTURE_SET == 1, "The bindless texture table comes right after the global set.");
+    // 128 bytes is the least every device supports
+    MLC_ASSERT(key.pushConstantSize <= MAX_PUSH_CONSTANTS_SIZE &&
+               key.pushConstantSize % 4 == 0,
+               "Push constant size has to be a multiple of 4, MAX_PUSH_CONSTANTS_SIZE at most.");
+    VkPushConstantRange pushConstantRange {
+        .stageFlags = key.pushConstantStages,
+        .offset = 0,
+        .size = key.pushConstantSize
+    };
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
         .flags = 0,
-        .setLayoutCount = 2,
+        .setLayoutCount = static_cast<uint32_t>(layouts.size()),
         .pSetLayouts = layouts.data(),
-        .pushConstantRangeCount = 0,
-        .pPushConstantRanges = nullptr
+        .pushConstantRangeCount = key.pushConstantSize > 0 ? 1u : 0u,
+        .pPushConstantRanges = &pushConstantRange
     };
 
-    VkResult result = vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, MLC_VULKAN_ALLOCATOR, &m_pipelineLayout);
+    VkResult result = vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, MLC_VULKAN_ALLOCATOR, &pipeline.m_layout);
     MLC_ASSERT(result == VK_SUCCESS, "Failed to create pipeline layout.");
 
     // ----- Graphics Pipeline -----
 
+    // Attachment formats take the render pass' place with dynamic rendering
+    VkPipelineRenderingCreateInfo renderingCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .viewMask = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &key.colorFormat,
+        .depthAttachmentFormat = key.depthFormat,
+        .stencilAttachmentFormat = _HasStencilComponent(key.depthFormat) ? key.depthFormat : VK_FORMAT_UNDEFINED
+    };
+
     VkGraphicsPipelineCreateInfo pipelineCreateInfo {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext = VK_NULL_HANDLE,
+        .pNext = m_dynamicRendering ? &renderingCreateInfo : VK_NULL_HANDLE,
         .flags = 0,
         .stageCount = static_cast<uint32_t>(shaderStages.size()),
         .pStages = shaderStages.data(),
-        .pVertexInputState = &vertexInputCreateInfo,
+        .pVertexInputState = m_vertexInputDynamicStateSupported ? nullptr : &vertexInputCreateInfo,
         .pInputAssemblyState = &inputAssemblyCreateInfo,
         .pTessellationState = nullptr,
         .pViewportState = &viewportStateCreateInfo,
@@ -881,8 +1456,8 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
         .pDepthStencilState = &depthStencilCreateInfo,
         .pColorBlendState = &colorBlendingCreateInfo,
         .pDynamicState = &dynamicStateCreateInfo,
-        .layout = m_pipelineLayout,
-        .renderPass = m_renderPass,
+        .layout = pipeline.m_layout,
+        .renderPass = key.renderPass,
         .subpass = 0,
         .basePipelineHandle = VK_NULL_HANDLE,
         .basePipelineIndex = -1
@@ -890,15 +1465,15 @@ void VulkanManager::CreateGraphicsPipeline(const PipelineResources& pipeline_con
     // See https://vulkan-tutorial.com/Drawing_a_triangle/Graphics_pipeline_basics/Conclusion
     // for the last two parameters
     
-    result = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, MLC_VULKAN_ALLOCATOR, &m_graphicsPipeline);
+    auto pipelineStart = std::chrono::steady_clock::now();
+    result = vkCreateGraphicsPipelines(m_device, m_pipelineCache, 1, &pipelineCreateInfo, MLC_VULKAN_ALLOCATOR, &pipeline.m_pipeline);
     MLC_ASSERT(result == VK_SUCCESS, "Failed to create graphics pipeline.");
-}
+    std::chrono::duration<double, std::milli> pipelineTime = std::chrono::steady_clock::now() - pipelineStart;
+    MLC_DEBUG("Graphics pipeline created in {:.2f} ms.", pipelineTime.count());
 
-void VulkanManager::DestroyGraphicsPipeline()
-{
-    vkDeviceWaitIdle(m_device);  // TODO: Pipeline barrier?
-    vkDestroyPipeline(m_device, m_graphicsPipeline, MLC_VULKAN_ALLOCATOR);
-    vkDestroyPipelineLayout(m_device, m_pipelineLayout, MLC_VULKAN_ALLOCATOR);
+    pipeline.m_pushConstantSize = key.pushConstantSize;
+    pipeline.m_pushConstantStages = key.pushConstantStages;
+    pipeline.m_ready.store(true, std::memory_order_release);
 }
 
 MLC_NODISCARD std::vector<const char*> VulkanManager::_GetRequiredExtensions()
@@ -1193,6 +1768,26 @@ bool VulkanManager::_IsPhysicalDeviceSuitable(const VkPhysicalDevice& physical_d
     m_queueFamilyIndices = _FindQueueFamilies(physical_device);
 
     bool extensionsSupported = _CheckDeviceExtensionSupport(physical_device);
+
+    // Descriptor indexing the bindless texture table needs
+    bool bindlessSupported = false;
+    if (physicalDeviceProperties.apiVersion >= VK_API_VERSION_1_2)
+    {
+        VkPhysicalDeviceVulkan12Features vulkan12Features {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+            .pNext = VK_NULL_HANDLE
+        };
+        VkPhysicalDeviceFeatures2 features {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &vulkan12Features
+        };
+        vkGetPhysicalDeviceFeatures2(physical_device, &features);
+        bindlessSupported = vulkan12Features.runtimeDescriptorArray &&
+                            vulkan12Features.descriptorBindingPartiallyBound &&
+                            vulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+                            vulkan12Features.descriptorBindingUpdateUnusedWhilePending &&
+                            vulkan12Features.shaderSampledImageArrayNonUniformIndexing;
+    }
     bool swapChainAdequate = false;
     if (extensionsSupported)
     {
@@ -1203,6 +1798,7 @@ bool VulkanManager::_IsPhysicalDeviceSuitable(const VkPhysicalDevice& physical_d
     return m_queueFamilyIndices.IsComplete() &&
            extensionsSupported &&
            swapChainAdequate &&
+           bindlessSupported &&
            physicalDeviceFeatures.samplerAnisotropy;
 }
 
@@ -1251,24 +1847,106 @@ void VulkanManager::_CreateLogicalDevice()
         });
     }
 
-    VkPhysicalDeviceDescriptorIndexingFeatures descriptorIndexingFeatures {
-        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES
+    // Only a 1.3 device knows the 1.3 feature struct
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    bool vulkan13Device = properties.apiVersion >= VK_API_VERSION_1_3;
+
+    VkPhysicalDeviceVulkan13Features supportedVulkan13Features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .pNext = VK_NULL_HANDLE
     };
+    VkPhysicalDeviceVertexInputDynamicStateFeaturesEXT supportedVertexInputFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_INPUT_DYNAMIC_STATE_FEATURES_EXT,
+        .pNext = vulkan13Device ? &supportedVulkan13Features : VK_NULL_HANDLE
+    };
+    VkPhysicalDeviceVulkan12Features supportedVulkan12Features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = &supportedVertexInputFeatures
+    };
+    VkPhysicalDeviceFeatures2 supportedFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supportedVulkan12Features
+    };
+    vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
 
     VkPhysicalDeviceFeatures deviceFeatures {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // Optional, indirect draws fall back to one command per call without them
+    deviceFeatures.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+    m_multiDrawIndirectSupported = supportedFeatures.features.multiDrawIndirect == VK_TRUE;
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.features.drawIndirectFirstInstance;
+    m_drawIndirectFirstInstanceSupported = supportedFeatures.features.drawIndirectFirstInstance == VK_TRUE;
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = VK_NULL_HANDLE
+    };
+    vulkan12Features.timelineSemaphore = VK_TRUE;  // upload timeline
+    // Bindless texture table, checked by _IsPhysicalDeviceSuitable()
+    vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+    vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+    vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    vulkan12Features.drawIndirectCount = supportedVulkan12Features.drawIndirectCount;
+    m_drawIndirectCountSupported = m_multiDrawIndirectSupported &&
+                                   supportedVulkan12Features.drawIndirectCount == VK_TRUE;
+
+    // The extension is required, but the feature may still be off
+    VkPhysicalDeviceVertexInputDynamicStateFeaturesEXT vertexInputFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VERTEX_INPUT_DYNAMIC_STATE_FEATURES_EXT,
+        .pNext = VK_NULL_HANDLE,
+        .vertexInputDynamicState = supportedVertexInputFeatures.vertexInputDynamicState
+    };
+    vulkan12Features.pNext = &vertexInputFeatures;
+    m_vertexInputDynamicStateSupported = supportedVertexInputFeatures.vertexInputDynamicState == VK_TRUE;
+
+    VkPhysicalDeviceVulkan13Features vulkan13Features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .pNext = VK_NULL_HANDLE
+    };
+    m_dynamicRendering = USE_DYNAMIC_RENDERING && vulkan13Device && supportedVulkan13Features.dynamicRendering == VK_TRUE;
+    if (m_dynamicRendering)
+    {
+        vulkan13Features.dynamicRendering = VK_TRUE;
+        vertexInputFeatures.pNext = &vulkan13Features;
+    }
+    MLC_INFO("Rendering with {}.", m_dynamicRendering ? "dynamic rendering" : "render passes");
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+    std::vector<const char*> enabledExtensions(DEVICE_EXTENSIONS.begin(), DEVICE_EXTENSIONS.end());
+    for (const char* optionalExtension : OPTIONAL_DEVICE_EXTENSIONS)
+    {
+        bool supported = std::any_of(availableExtensions.begin(), availableExtensions.end(),
+            [&](const VkExtensionProperties& extension) {
+                return std::string_view(extension.extensionName) == optionalExtension;
+            });
+        fmt::print("Optional Device extension {} [{}]\n", optionalExtension, supported ? "SUPPORTED" : "UNSUPPORTED");
+        if (!supported) continue;
+
+        enabledExtensions.push_back(optionalExtension);
+        if (std::string_view(optionalExtension) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+        {
+            m_memoryBudgetSupported = true;
+        }
+    }
 
     // Device creation here
     VkDeviceCreateInfo deviceCreateInfo {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pNext = VK_NULL_HANDLE,
+        .pNext = &vulkan12Features,
         .flags = 0,
         .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
         .pQueueCreateInfos = queueCreateInfos.data(),
         .enabledLayerCount = ENABLE_VALIDATION_LAYERS ? static_cast<uint32_t>(VALIDATION_LAYERS.size()) : 0,
         .ppEnabledLayerNames = ENABLE_VALIDATION_LAYERS ? VALIDATION_LAYERS.data() : nullptr,
-        .enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size()),
-        .ppEnabledExtensionNames = DEVICE_EXTENSIONS.data(),
+        .enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size()),
+        .ppEnabledExtensionNames = enabledExtensions.data(),
         .pEnabledFeatures = &deviceFeatures
     };
 
@@ -1276,9 +1954,131 @@ void VulkanManager::_CreateLogicalDevice()
     VkResult result = vkCreateDevice(m_physicalDevice, &deviceCreateInfo, MLC_VULKAN_ALLOCATOR, &m_device);
     MLC_ASSERT(result == VK_SUCCESS, "Failed to create logical device.");
 
+    if (m_vertexInputDynamicStateSupported)
+    {
+        m_vkCmdSetVertexInputEXT = (PFN_vkCmdSetVertexInputEXT)vkGetDeviceProcAddr(m_device, "vkCmdSetVertexInputEXT");
+        m_vertexInputDynamicStateSupported = m_vkCmdSetVertexInputEXT != nullptr;
+    }
+    if (!m_vertexInputDynamicStateSupported)
+    {
+        MLC_WARN("No vertexInputDynamicState, vertex layouts are baked into the pipelines.");
+    }
+
     // Note: Get queues in main Init function
 }
 
+void VulkanManager::_CreatePipelineCache()
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+    std::filesystem::path path = GetExecutableDirectory() / PIPELINE_CACHE_FILE_NAME;
+    std::vector<char> data;
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (file.is_open())
+    {
+        size_t fileSize = static_cast<size_t>(file.tellg());
+        PipelineCacheFileHeader header {};
+        file.seekg(0);
+        if (fileSize >= sizeof(header))
+        {
+            file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        }
+
+        if (fileSize < sizeof(header) ||
+            header.magic != PIPELINE_CACHE_FILE_MAGIC ||
+            header.dataSize != fileSize - sizeof(header))
+        {
+            MLC_WARN("Pipeline cache {} is corrupted, starting empty.", path.string());
+        }
+        else if (header.vendorID != properties.vendorID ||
+                 header.deviceID != properties.deviceID ||
+                 header.driverVersion != properties.driverVersion ||
+                 memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+        {
+            MLC_INFO("Pipeline cache {} was made by another device or driver, starting empty.", path.string());
+        }
+        else
+        {
+            data.resize(header.dataSize);
+            file.read(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file)
+            {
+                MLC_WARN("Failed to read pipeline cache {}, starting empty.", path.string());
+                data.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo pipelineCacheCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .initialDataSize = data.size(),
+        .pInitialData = data.empty() ? nullptr : data.data()
+    };
+    VkResult result = vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, MLC_VULKAN_ALLOCATOR, &m_pipelineCache);
+    if (result != VK_SUCCESS && !data.empty())
+    {
+        // The driver has the final say on whether the data is usable
+        MLC_WARN("Driver rejected pipeline cache {}, starting empty.", path.string());
+        pipelineCacheCreateInfo.initialDataSize = 0;
+        pipelineCacheCreateInfo.pInitialData = nullptr;
+        data.clear();
+        result = vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, MLC_VULKAN_ALLOCATOR, &m_pipelineCache);
+    }
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create pipeline cache.");
+
+    if (!data.empty())
+    {
+        MLC_INFO("Loaded pipeline cache {} ({} bytes).", path.string(), data.size());
+    }
+}
+
+void VulkanManager::_SavePipelineCache() const
+{
+    size_t dataSize = 0;
+    VkResult result = vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr);
+    if (result != VK_SUCCESS || dataSize == 0) return;
+
+    std::vector<char> data(dataSize);
+    result = vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data());
+    if (result != VK_SUCCESS) return;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    PipelineCacheFileHeader header {
+        .magic = PIPELINE_CACHE_FILE_MAGIC,
+        .dataSize = static_cast<uint32_t>(dataSize),
+        .vendorID = properties.vendorID,
+        .deviceID = properties.deviceID,
+        .driverVersion = properties.driverVersion
+    };
+    memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    // Written next to the old file and swapped in, a crash mid-write leaves the old one intact
+    std::filesystem::path path = GetExecutableDirectory() / PIPELINE_CACHE_FILE_NAME;
+    std::filesystem::path tempPath = path;
+    tempPath += ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), static_cast<std::streamsize>(dataSize));
+        if (!file)
+        {
+            MLC_WARN("Failed to write pipeline cache {}.", tempPath.string());
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error)
+    {
+        MLC_WARN("Failed to replace pipeline cache {}: {}", path.string(), error.message());
+        std::filesystem::remove(tempPath, error);
+    }
+}
+
 void VulkanManager::_GetQueues()
 {
     // If the graphics and present queues are the same, they'll have the same address
@@ -1488,6 +2288,27 @@ void VulkanManager::_CreateRenderPass()
                                          MLC_VULKAN_ALLOCATOR,
                                          &m_renderPass);
     MLC_ASSERT(result == VK_SUCCESS, "Failed to create render pass.");                                        
+
+    // Occlusion culling splits the frame in two, the early pass keeps depth around for the Hi-Z pyramid
+    attachmentsDescs[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachmentsDescs[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    result = vkCreateRenderPass(m_device, &renderPassCreateInfo, MLC_VULKAN_ALLOCATOR, &m_earlyRenderPass);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create early render pass.");
+
+    // and the late pass draws on top of it
+    attachmentsDescs[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachmentsDescs[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachmentsDescs[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    attachmentsDescs[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachmentsDescs[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachmentsDescs[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    subpassDependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    subpassDependency.dstStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    subpassDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    result = vkCreateRenderPass(m_device, &renderPassCreateInfo, MLC_VULKAN_ALLOCATOR, &m_lateRenderPass);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create late render pass.");
 }
 
 void VulkanManager::_CreateFramebuffers()
@@ -1551,17 +2372,8 @@ void VulkanManager::_CreateCommandPools()
 
 void VulkanManager::_CreateCommandBuffers()
 {
-    m_graphicsCmdBuffers.resize(MAX_FRAMES_IN_FLIGHT);
     m_transferCmdBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
-    VkCommandBufferAllocateInfo graphicsCmdBufferAllocInfo {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .commandPool = m_graphicsCmdPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = static_cast<uint32_t>(m_graphicsCmdBuffers.size())
-    };
-
     VkCommandBufferAllocateInfo transferCmdBufferAllocInfo {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .pNext = VK_NULL_HANDLE,
@@ -1571,184 +2383,2151 @@ void VulkanManager::_CreateCommandBuffers()
     };
 
     VkResult result;
-    result = vkAllocateCommandBuffers(m_device, &graphicsCmdBufferAllocInfo, m_graphicsCmdBuffers.data());
-    MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate Graphics command buffers.");
     result = vkAllocateCommandBuffers(m_device, &transferCmdBufferAllocInfo, m_transferCmdBuffers.data());
     MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate Transfer command buffers.");
 }
 
-void VulkanManager::_RecordCommandBuffer(VkCommandBuffer command_buffer,
-                                         uint32_t swch_image_index,
-                                         const RenderResources& render_resources) const
+void VulkanManager::_CreateRetainedCommands()
 {
-    VkCommandBufferBeginInfo beginInfo {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .flags = 0,
-        .pInheritanceInfo = nullptr  // optional
-    };
-
-    VkResult result = vkBeginCommandBuffer(command_buffer, &beginInfo);
-    MLC_ASSERT(result == VK_SUCCESS, "Failed to create command buffer.");
-
-    std::array<VkClearValue, 2> clearValues {};
-    clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-    clearValues[1].depthStencil = { 1.0f, 0 };
-    VkRenderPassBeginInfo renderPassBeginInfo {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+    VkCommandPoolCreateInfo commandPoolCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .pNext = VK_NULL_HANDLE,
-        .renderPass = m_renderPass,
-        .framebuffer = m_swapChainFramebuffers[swch_image_index],
-        .renderArea = {
-            .offset = { 0, 0 },
-            .extent = m_swapChainExtent
-        },
-        .clearValueCount = static_cast<uint32_t>(clearValues.size()),
-        .pClearValues = clearValues.data()
-    };
-    vkCmdBeginRenderPass(command_buffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
-
-    VkViewport viewport {
-        .x = 0,
-        .y = static_cast<float>(m_swapChainExtent.height),
-        .width = static_cast<float>(m_swapChainExtent.width),
-        .height = -static_cast<float>(m_swapChainExtent.height),
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
-    };
-    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-    VkRect2D scissor {
-        .offset = { 0, 0 },
-        .extent = m_swapChainExtent
+        .flags = 0,  // reset as a whole when re-recorded
+        .queueFamilyIndex = m_queueFamilyIndices.graphicsFamily.value()
     };
-    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
-
-    const VertexArray* vertexArray = render_resources.vertexArray;
-    std::array<VkBuffer, 1> vertexBuffers = { vertexArray->GetVertexBuffer().m_handle };
-    std::array<VkDeviceSize, 1> offsets = { 0 }; 
-    vkCmdBindVertexBuffers(command_buffer, 0, 1, vertexBuffers.data(), offsets.data());
-    vkCmdBindIndexBuffer(command_buffer, vertexArray->GetIndexBuffer().m_handle, 0, VK_INDEX_TYPE_UINT16);
-
-    const Material& material = m_pipelineConfig.material;
-    // vkDeviceWaitIdle(m_device);
-    // material.GetAlbedo()->Bind();
-    vkCmdBindDescriptorSets(command_buffer,
-                            VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            m_pipelineLayout,
-                            0,
-                            m_descriptorSets.size(),
-                            m_descriptorSets.data(),
-                            0,
-                            nullptr);
 
-    vkCmdDrawIndexed(command_buffer,
-                     vertexArray->GetIndicesCount(),
-                     1,
-                     0,
-                     0,
-                     0);  // TODO
+    m_retainedCommands.resize(MAX_FRAMES_IN_FLIGHT * m_swapChainImages.size());
+    for (RetainedCommands& retainedCommands : m_retainedCommands)
+    {
+        retainedCommands.recordingContexts.resize(m_recordingThreads.GetThreadCount());
+        for (RecordingContext& context : retainedCommands.recordingContexts)
+        {
+            VkResult result = vkCreateCommandPool(m_device, &commandPoolCreateInfo, MLC_VULKAN_ALLOCATOR, &context.commandPool);
+            MLC_ASSERT(result == VK_SUCCESS, "Failed to create recording command pool.");
+
+            VkCommandBufferAllocateInfo allocateInfo {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .pNext = VK_NULL_HANDLE,
+                .commandPool = context.commandPool,
+                .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+                .commandBufferCount = static_cast<uint32_t>(context.secondaryCmdBuffers.size())
+            };
+            result = vkAllocateCommandBuffers(m_device, &allocateInfo, context.secondaryCmdBuffers.data());
+            MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate secondary command buffers.");
+        }
 
-    vkCmdEndRenderPass(command_buffer);
+        VkCommandBufferAllocateInfo allocateInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .commandPool = retainedCommands.recordingContexts[0].commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VkResult result = vkAllocateCommandBuffers(m_device, &allocateInfo, &retainedCommands.primaryCmdBuffer);
+        MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate Graphics command buffer.");
+        retainedCommands.buildId = 0;
+    }
+}
 
-    result = vkEndCommandBuffer(command_buffer);
-    MLC_ASSERT(result == VK_SUCCESS, "Failed to record command buffer.");
+void VulkanManager::_DestroyRetainedCommands()
+{
+    // Only called with the device idle
+    for (RetainedCommands& retainedCommands : m_retainedCommands)
+    {
+        for (RecordingContext& context : retainedCommands.recordingContexts)
+        {
+            vkDestroyCommandPool(m_device, context.commandPool, MLC_VULKAN_ALLOCATOR);
+        }
+    }
+    m_retainedCommands.clear();
 }
 
-VkFormat VulkanManager::_FindSupportedFormat(const std::vector<VkFormat>& candidates,
-                                         VkImageTiling tiling,
-                                         VkFormatFeatureFlags features) const
+uint64_t VulkanManager::_HashDrawState(const std::vector<RenderResources>& render_list) const
 {
-    for (VkFormat format : candidates)
+    uint64_t hash = 0;
+    HashCombine(hash, m_drawStateEpoch);
+    HashCombine(hash, m_hasCullingFrustum);
+    if (m_hasCullingFrustum && !_IsCullingActive())
     {
-        VkFormatProperties properties;
-        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+        // Culled on the CPU it decides what's recorded, the GPU reads it from m_cullFrustumBuffer
+        HashBytes(hash, &m_cullingMatrix, sizeof(m_cullingMatrix));
+    }
+    HashCombine(hash, _IsOcclusionCullingActive() && m_hiZValid);
 
-        if (tiling == VK_IMAGE_TILING_LINEAR && (properties.linearTilingFeatures & features) == features)
+    HashCombine(hash, render_list.size());
+    for (const RenderResources& draw : render_list)
+    {
+        // Same draws _SortDraws skips
+        const GraphicsPipeline* pipeline = _GetDrawPipeline(draw);
+        if (!draw.vertexArray || !pipeline) continue;
+
+        const Texture2D* albedo = draw.material.GetAlbedo();
+        HashCombine(hash, reinterpret_cast<uintptr_t>(pipeline));
+        HashCombine(hash, reinterpret_cast<uintptr_t>(draw.vertexArray));
+        HashCombine(hash, draw.vertexArray->GetFirstVertex());
+        HashCombine(hash, draw.vertexArray->GetFirstIndex());
+        HashCombine(hash, reinterpret_cast<uintptr_t>(albedo));
+        if (albedo)
         {
-            return format;
+            // Written into the instances, changes when it's evicted and loaded again
+            HashCombine(hash, albedo->GetBindlessIndex());
         }
-        else if (tiling == VK_IMAGE_TILING_OPTIMAL && (properties.optimalTilingFeatures & features) == features)
+        HashCombine(hash, reinterpret_cast<uintptr_t>(draw.uniformData));
+        HashCombine(hash, draw.uniformSize);
+        // Recorded into the command buffer, so its contents count
+        HashCombine(hash, reinterpret_cast<uintptr_t>(draw.pushConstantData));
+        if (draw.pushConstantData && pipeline->m_pushConstantSize > 0)
         {
-            return format;
+            HashBytes(hash, draw.pushConstantData, pipeline->m_pushConstantSize);
+        }
+        HashBytes(hash, &draw.depth, sizeof(draw.depth));
+        HashCombine(hash, reinterpret_cast<uintptr_t>(draw.instanceBuffer));
+        if (draw.instanceBuffer)
+        {
+            HashCombine(hash, reinterpret_cast<uint64_t>(draw.instanceBuffer->GetBuffer().m_handle));
+            HashCombine(hash, draw.instanceBuffer->GetInstanceCount());
         }
+        else
+        {
+            HashBytes(hash, &draw.instance, sizeof(draw.instance));
+            HashBytes(hash, &draw.boundingSphere, sizeof(draw.boundingSphere));
+        }
+        HashCombine(hash, draw.indexOffset.size());
+        HashBytes(hash, draw.indexOffset.data(), sizeof(uint32_t) * draw.indexOffset.size());
+        HashBytes(hash, draw.indexCount.data(), sizeof(uint32_t) * draw.indexCount.size());
+        HashCombine(hash, draw.vertexOffset.size());
+        HashBytes(hash, draw.vertexOffset.data(), sizeof(int32_t) * draw.vertexOffset.size());
     }
-    MLC_ASSERT(false, "");
-    MLC_ERROR("Failed to find supported format, returning VK_FORMAT_D32_SFLOAT.");
-    return candidates.at(0);
-}
 
-VkFormat VulkanManager::_FindDepthFormat() const
-{
-    return _FindSupportedFormat(
-        { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
-        VK_IMAGE_TILING_OPTIMAL,
-        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-    );
+    return hash;
 }
 
-bool VulkanManager::_HasStencilComponent(VkFormat format) const
+void VulkanManager::_BuildRetainedDraws(const std::vector<RenderResources>& render_list)
 {
-    return (format == VK_FORMAT_D32_SFLOAT_S8_UINT) || (format == VK_FORMAT_D24_UNORM_S8_UINT);
+    // The GPU is done with this frame's part, and so are the command buffers recorded from it
+    m_uniformRingHead = 0;
+    m_instanceRingHead = 0;
+    m_indirectRingHead = 0;
+
+    RetainedDraws& retainedDraws = m_retainedDraws[m_currentFrameIndex];
+    retainedDraws.uniforms.clear();
+    retainedDraws.textures.clear();
+
+    bool culling = _IsCullingActive();
+    _SortDraws(render_list, m_hasCullingFrustum && !culling);
+    _BuildDrawBatches(render_list, culling, retainedDraws);
+
+    retainedDraws.buildId = ++m_retainedBuildCount;
+    retainedDraws.drawBatches = m_drawBatches;
+    retainedDraws.drawCommandCount = m_drawCommandCount;
+    retainedDraws.cullObjectCount = m_cullObjectCount;
+    retainedDraws.drawCountsOffset = m_drawCountsOffset;
 }
 
-void VulkanManager::_CreateDepthResources()
+void VulkanManager::_ReuseRetainedDraws()
 {
-    VkFormat depthFormat = _FindDepthFormat();
-    AllocateImage2D(m_depthImage,
-                    m_swapChainExtent.width,
-                    m_swapChainExtent.height,
-                    depthFormat,
-                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    m_depthImageView = _CreateImageView(m_depthImage.m_handle, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    const RetainedDraws& retainedDraws = m_retainedDraws[m_currentFrameIndex];
 
-    TransitionImageLayout(m_depthImage,
-                          depthFormat,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    // Same offsets as when it was built, the descriptors recorded with them still point there
+    char* frameData = static_cast<char*>(m_uniformRingBuffer.m_allocation.mappedData) +
+                      m_currentFrameIndex * UNIFORM_RING_SIZE_PER_FRAME;
+    for (const RetainedUniform& uniform : retainedDraws.uniforms)
+    {
+        memcpy(frameData + uniform.offset, uniform.data, uniform.size);
+    }
+    for (const Texture2D* texture : retainedDraws.textures)
+    {
+        texture->MarkUsed(m_frameCount);
+    }
+
+    // Only needed if it's recorded again for another swap chain image
+    m_drawBatches = retainedDraws.drawBatches;
+    m_drawCommandCount = retainedDraws.drawCommandCount;
+    m_cullObjectCount = retainedDraws.cullObjectCount;
+    m_drawCountsOffset = retainedDraws.drawCountsOffset;
 }
 
-void VulkanManager::_CreateSyncObjects()
+void VulkanManager::_RecordCommandBuffer(VkCommandBuffer command_buffer, uint32_t swch_image_index) const
 {
-    m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    m_renderFinishedSemaphores.resize(m_swapChainImages.size());
-    m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    bool culling = _IsCullingActive();
 
-    VkSemaphoreCreateInfo semaphoreCreateInfo {
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        .pNext = VK_NULL_HANDLE,
-        .flags = 0  
-    };
-    VkFenceCreateInfo fenceCreateInfo {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    VkCommandBufferBeginInfo beginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext = VK_NULL_HANDLE,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT
+        .flags = 0,
+        .pInheritanceInfo = nullptr  // optional
     };
 
-    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    VkResult result = vkBeginCommandBuffer(command_buffer, &beginInfo);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create command buffer.");
+
+    const DrawTarget target = _GetSwapChainDrawTarget(swch_image_index);
+    if (!culling)
     {
-        bool result;
-        result = vkCreateSemaphore(m_device,
-                                   &semaphoreCreateInfo,
-                                   MLC_VULKAN_ALLOCATOR,
-                                   &m_imageAvailableSemaphores[i]) == VK_SUCCESS
-              && vkCreateFence(m_device,
-                               &fenceCreateInfo,
-                               MLC_VULKAN_ALLOCATOR,
-                               &m_inFlightFences[i]) == VK_SUCCESS;
-        MLC_ASSERT(result, "Failed to create sync objects.");
+        _RecordDrawBatches(command_buffer, DrawPass::FULL, target, swch_image_index, nullptr, nullptr);
     }
-    for (uint32_t i = 0; i < m_swapChainImages.size(); i++)
+    else if (!_IsOcclusionCullingActive())
     {
-        VkResult result = vkCreateSemaphore(m_device,
-                                &semaphoreCreateInfo,
-                                MLC_VULKAN_ALLOCATOR,
-                                &m_renderFinishedSemaphores[i]);
-        MLC_ASSERT(result == VK_SUCCESS, "Failed to create sync objects.");
+        _RecordCulling(command_buffer, false);
+        _RecordDrawBatches(command_buffer,
+                           DrawPass::FULL,
+                           target,
+                           swch_image_index,
+                           &m_culledCommandBuffer,
+                           &m_drawCountBuffer);
     }
+    else
+    {
+        // Whatever passes against last frame's pyramid goes first, its depth decides the rest
+        _RecordCulling(command_buffer, true);
+        _RecordDrawBatches(command_buffer,
+                           DrawPass::EARLY,
+                           target,
+                           swch_image_index,
+                           &m_culledCommandBuffer,
+                           &m_drawCountBuffer);
+        _RecordLateCulling(command_buffer);
+        _RecordDrawBatches(command_buffer,
+                           DrawPass::LATE,
+                           target,
+                           swch_image_index,
+                           &m_lateCulledCommandBuffer,
+                           &m_lateDrawCountBuffer);
+    }
+
+    result = vkEndCommandBuffer(command_buffer);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to record command buffer.");
+}
+
+void VulkanManager::_RecordDrawBatches(VkCommandBuffer command_buffer,
+                                       DrawPass pass,
+                                       const DrawTarget& target,
+                                       uint32_t swch_image_index,
+                                       const GPUBuffer* culled_commands,
+                                       const GPUBuffer* draw_counts) const
+{
+    const uint32_t batchCount = static_cast<uint32_t>(m_drawBatches.size());
+    const uint32_t chunkCount = std::min(m_recordingThreads.GetThreadCount(),
+                                         batchCount / MIN_DRAW_BATCHES_PER_RECORDING_THREAD);
+    if (chunkCount <= 1)
+    {
+        _BeginDrawPass(command_buffer, pass, target, false);
+        _RecordDrawBatchRange(command_buffer, target.extent, 0, batchCount, culled_commands, draw_counts);
+        _EndDrawPass(command_buffer, pass, target);
+        return;
+    }
+
+    // Occlusion culling draws in two passes, the late one has its own secondary command buffers
+    const uint32_t passIndex = pass == DrawPass::LATE ? 1 : 0;
+    const VkFormat colorFormat = target.color.format;
+    const VkFormat depthFormat = target.depth.format;
+
+    // Chunk i goes to context i, so every command pool is only touched by one thread at a time
+    const RecordingContext* contexts =
+        m_retainedCommands[m_currentFrameIndex * m_swapChainImages.size() + swch_image_index].recordingContexts.data();
+    std::array<VkCommandBuffer, MAX_RECORDING_THREADS> secondaryCmdBuffers;
+    m_recordingThreads.Run(chunkCount, [&](uint32_t chunk) {
+        VkCommandBuffer secondaryCmdBuffer = contexts[chunk].secondaryCmdBuffers[passIndex];
+        secondaryCmdBuffers[chunk] = secondaryCmdBuffer;
+
+        VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .flags = 0,
+            .viewMask = 0,
+            .colorAttachmentCount = 1,
+            .pColorAttachmentFormats = &colorFormat,
+            .depthAttachmentFormat = depthFormat,
+            .stencilAttachmentFormat = _HasStencilComponent(depthFormat) ? depthFormat : VK_FORMAT_UNDEFINED,
+            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+        };
+        VkCommandBufferInheritanceInfo inheritanceInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .pNext = m_dynamicRendering ? &inheritanceRenderingInfo : VK_NULL_HANDLE,
+            .renderPass = m_dynamicRendering ? VK_NULL_HANDLE : _GetDrawPassRenderPass(pass),
+            .subpass = 0,
+            .framebuffer = m_dynamicRendering ? VK_NULL_HANDLE : target.framebuffer,
+            .occlusionQueryEnable = VK_FALSE,
+            .queryFlags = 0,
+            .pipelineStatistics = 0
+        };
+        VkCommandBufferBeginInfo beginInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,  // resubmitted while the frame is retained
+            .pInheritanceInfo = &inheritanceInfo
+        };
+        VkResult result = vkBeginCommandBuffer(secondaryCmdBuffer, &beginInfo);
+        MLC_ASSERT(result == VK_SUCCESS, "Failed to begin secondary command buffer.");
+
+        // Contiguous chunks, draws still go out in sort order
+        _RecordDrawBatchRange(secondaryCmdBuffer,
+                              target.extent,
+                              batchCount * chunk / chunkCount,
+                              batchCount * (chunk + 1) / chunkCount,
+                              culled_commands,
+                              draw_counts);
+
+        result = vkEndCommandBuffer(secondaryCmdBuffer);
+        MLC_ASSERT(result == VK_SUCCESS, "Failed to record secondary command buffer.");
+    });
+
+    _BeginDrawPass(command_buffer, pass, target, true);
+    vkCmdExecuteCommands(command_buffer, chunkCount, secondaryCmdBuffers.data());
+    _EndDrawPass(command_buffer, pass, target);
+}
+
+VulkanManager::DrawTarget VulkanManager::_GetSwapChainDrawTarget(uint32_t swch_image_index) const
+{
+    VkClearValue colorClearValue {};
+    colorClearValue.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+    VkClearValue depthClearValue {};
+    depthClearValue.depthStencil = { 1.0f, 0 };
+
+    // Both are cleared, what was there before doesn't matter
+    return DrawTarget {
+        .color = DrawAttachment {
+            .image = m_swapChainImages[swch_image_index],
+            .view = m_swapChainImageViews[swch_image_index],
+            .format = m_swapChainImageFormat,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .clearValue = colorClearValue
+        },
+        .depth = DrawAttachment {
+            .image = m_depthImage.m_handle,
+            .view = m_depthImageView,
+            .format = _FindDepthFormat(),
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .clearValue = depthClearValue
+        },
+        .framebuffer = m_swapChainFramebuffers[swch_image_index],
+        .extent = m_swapChainExtent
+    };
+}
+
+void VulkanManager::_BeginDrawPass(VkCommandBuffer command_buffer,
+                                   DrawPass pass,
+                                   const DrawTarget& target,
+                                   bool secondary_contents) const
+{
+    VkRect2D renderArea {
+        .offset = { 0, 0 },
+        .extent = target.extent
+    };
+
+    if (!m_dynamicRendering)
+    {
+        std::array<VkClearValue, 2> clearValues { target.color.clearValue, target.depth.clearValue };
+        VkRenderPassBeginInfo renderPassBeginInfo {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .renderPass = _GetDrawPassRenderPass(pass),
+            .framebuffer = target.framebuffer,
+            .renderArea = renderArea,
+            .clearValueCount = static_cast<uint32_t>(clearValues.size()),
+            .pClearValues = clearValues.data()
+        };
+        vkCmdBeginRenderPass(command_buffer,
+                             &renderPassBeginInfo,
+                             secondary_contents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+        return;
+    }
+
+    // What the render passes' initial layouts and external dependencies did
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (_HasStencilComponent(target.depth.format))
+    {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    bool late = pass == DrawPass::LATE;
+    if (late)
+    {
+        // Depth was already moved back by _RecordLateCulling()
+        RecordMemoryBarrier(command_buffer,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                            VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    }
+    else
+    {
+        std::array<VkImageMemoryBarrier, 2> attachmentBarriers {
+            VkImageMemoryBarrier {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = VK_NULL_HANDLE,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                .oldLayout = target.color.initialLayout,
+                .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = target.color.image,
+                .subresourceRange = VkImageSubresourceRange {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                }
+            },
+            VkImageMemoryBarrier {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = VK_NULL_HANDLE,
+                .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .oldLayout = target.depth.initialLayout,
+                .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = target.depth.image,
+                .subresourceRange = VkImageSubresourceRange {
+                    .aspectMask = depthAspect,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1
+                }
+            }
+        };
+        // The swap chain image waits on the acquire semaphore, which is waited on at COLOR_ATTACHMENT_OUTPUT
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             0,
+                             0, nullptr,
+                             0, nullptr,
+                             static_cast<uint32_t>(attachmentBarriers.size()), attachmentBarriers.data());
+    }
+
+    // The early pass hands both attachments to the late one
+    VkRenderingAttachmentInfo colorAttachment {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .imageView = target.color.view,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE,
+        .resolveImageView = VK_NULL_HANDLE,
+        .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : target.color.loadOp,
+        .storeOp = pass == DrawPass::EARLY ? VK_ATTACHMENT_STORE_OP_STORE : target.color.storeOp,
+        .clearValue = target.color.clearValue
+    };
+    VkRenderingAttachmentInfo depthAttachment {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .imageView = target.depth.view,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .resolveMode = VK_RESOLVE_MODE_NONE,
+        .resolveImageView = VK_NULL_HANDLE,
+        .resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : target.depth.loadOp,
+        .storeOp = pass == DrawPass::EARLY ? VK_ATTACHMENT_STORE_OP_STORE : target.depth.storeOp,
+        .clearValue = target.depth.clearValue
+    };
+    // Pipelines are made with the stencil format too when there is one, it's never used
+    VkRenderingAttachmentInfo stencilAttachment = depthAttachment;
+    stencilAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    stencilAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+    VkRenderingInfo renderingInfo {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = secondary_contents ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0u,
+        .renderArea = renderArea,
+        .layerCount = 1,
+        .viewMask = 0,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &colorAttachment,
+        .pDepthAttachment = &depthAttachment,
+        .pStencilAttachment = _HasStencilComponent(target.depth.format) ? &stencilAttachment : nullptr
+    };
+    vkCmdBeginRendering(command_buffer, &renderingInfo);
+}
+
+void VulkanManager::_EndDrawPass(VkCommandBuffer command_buffer, DrawPass pass, const DrawTarget& target) const
+{
+    if (!m_dynamicRendering)
+    {
+        vkCmdEndRenderPass(command_buffer);
+        return;
+    }
+
+    vkCmdEndRendering(command_buffer);
+    if (pass == DrawPass::EARLY) return;
+
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (_HasStencilComponent(target.depth.format))
+    {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    std::array<VkImageMemoryBarrier, 2> finalBarriers;
+    uint32_t finalBarrierCount = 0;
+    VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    auto toFinalLayout = [&](const DrawAttachment& attachment,
+                             VkImageLayout layout,
+                             VkAccessFlags access,
+                             VkImageAspectFlags aspect) {
+        if (attachment.finalLayout == layout) return;
+
+        // Presenting needs no access mask, anything else is made visible to whatever comes next
+        bool present = attachment.finalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        if (!present)
+        {
+            dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        }
+        finalBarriers[finalBarrierCount++] = VkImageMemoryBarrier {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = VK_NULL_HANDLE,
+            .srcAccessMask = access,
+            .dstAccessMask = present ? 0u : VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+            .oldLayout = layout,
+            .newLayout = attachment.finalLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = attachment.image,
+            .subresourceRange = VkImageSubresourceRange {
+                .aspectMask = aspect,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+    };
+    toFinalLayout(target.color,
+                  VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                  VK_IMAGE_ASPECT_COLOR_BIT);
+    toFinalLayout(target.depth,
+                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                  depthAspect);
+    if (finalBarrierCount == 0) return;
+
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         dstStage,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         finalBarrierCount, finalBarriers.data());
+}
+
+VkRenderPass VulkanManager::_GetDrawPassRenderPass(DrawPass pass) const
+{
+    switch (pass)
+    {
+    case DrawPass::EARLY:
+        return m_earlyRenderPass;
+    case DrawPass::LATE:
+        return m_lateRenderPass;
+    default:
+        return m_renderPass;
+    }
+}
+
+void VulkanManager::_RecordDrawBatchRange(VkCommandBuffer command_buffer,
+                                          const VkExtent2D& extent,
+                                          uint32_t first_batch,
+                                          uint32_t end_batch,
+                                          const GPUBuffer* culled_commands,
+                                          const GPUBuffer* draw_counts) const
+{
+    VkViewport viewport {
+        .x = 0,
+        .y = static_cast<float>(extent.height),
+        .width = static_cast<float>(extent.width),
+        .height = -static_cast<float>(extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    };
+    vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+    VkRect2D scissor {
+        .offset = { 0, 0 },
+        .extent = extent
+    };
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    // Every VertexArray lives in the geometry arena, meshes are picked with the draw's offsets
+    VkDeviceSize vertexBufferOffset = 0;
+    vkCmdBindVertexBuffers(command_buffer,
+                           VERTEX_BINDING_INDEX_VERTEX,
+                           1,
+                           &m_geometryVertexBuffer.m_handle,
+                           &vertexBufferOffset);
+    vkCmdBindIndexBuffer(command_buffer, m_geometryIndexBuffer.m_handle, 0, VK_INDEX_TYPE_UINT16);
+
+    const GraphicsPipeline* boundPipeline = nullptr;
+    const VertexInputLayout* boundVertexInput = nullptr;
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+    uint32_t boundDynamicOffset = 0;
+    VkBuffer boundInstanceBuffer = VK_NULL_HANDLE;
+    VkDeviceSize boundInstanceBufferOffset = 0;
+    const void* boundPushConstantData = nullptr;
+    for (uint32_t batchIndex = first_batch; batchIndex < end_batch; batchIndex++)
+    {
+        const DrawBatch& batch = m_drawBatches[batchIndex];
+        if (batch.pipeline != boundPipeline)
+        {
+            vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline->m_pipeline);
+            // Layouts with different push constant ranges aren't compatible, the set and constants go again
+            if (!boundPipeline || batch.pipeline->m_layout != boundPipeline->m_layout)
+            {
+                vkCmdBindDescriptorSets(command_buffer,
+                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        batch.pipeline->m_layout,
+                                        BINDLESS_TEXTURE_SET,
+                                        1,
+                                        &m_bindlessTextureSet,
+                                        0,
+                                        nullptr);
+                boundSet = VK_NULL_HANDLE;
+                boundPushConstantData = nullptr;
+            }
+            boundPipeline = batch.pipeline;
+        }
+        if (batch.vertexInput && batch.vertexInput != boundVertexInput)
+        {
+            m_vkCmdSetVertexInputEXT(command_buffer,
+                                     static_cast<uint32_t>(batch.vertexInput->bindings.size()),
+                                     batch.vertexInput->bindings.data(),
+                                     static_cast<uint32_t>(batch.vertexInput->attributes.size()),
+                                     batch.vertexInput->attributes.data());
+            boundVertexInput = batch.vertexInput;
+        }
+        if (batch.descriptorSet != boundSet || batch.dynamicOffset != boundDynamicOffset)
+        {
+            vkCmdBindDescriptorSets(command_buffer,
+                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    batch.pipeline->m_layout,
+                                    0,
+                                    1,
+                                    &batch.descriptorSet,
+                                    m_hasUniformRingBinding ? 1 : 0,
+                                    &batch.dynamicOffset);
+            boundSet = batch.descriptorSet;
+            boundDynamicOffset = batch.dynamicOffset;
+        }
+        if (batch.instanceBuffer != boundInstanceBuffer || batch.instanceBufferOffset != boundInstanceBufferOffset)
+        {
+            vkCmdBindVertexBuffers(command_buffer,
+                                   VERTEX_BINDING_INDEX_INSTANCE,
+                                   1,
+                                   &batch.instanceBuffer,
+                                   &batch.instanceBufferOffset);
+            boundInstanceBuffer = batch.instanceBuffer;
+            boundInstanceBufferOffset = batch.instanceBufferOffset;
+        }
+        if (batch.pushConstantData && batch.pushConstantData != boundPushConstantData)
+        {
+            vkCmdPushConstants(command_buffer,
+                               batch.pipeline->m_layout,
+                               batch.pipeline->m_pushConstantStages,
+                               0,
+                               batch.pipeline->m_pushConstantSize,
+                               batch.pushConstantData);
+            boundPushConstantData = batch.pushConstantData;
+        }
+
+        _DrawIndirectBatch(command_buffer, batchIndex, culled_commands, draw_counts);
+    }
+}
+
+void VulkanManager::_BuildDrawBatches(const std::vector<RenderResources>& render_list,
+                                      bool culling,
+                                      RetainedDraws& retained_draws) const
+{
+    m_drawBatches.clear();
+    m_drawCommandCount = 0;
+    m_cullObjectCount = 0;
+
+    const VkDeviceSize indirectFrameOffset = m_currentFrameIndex * INDIRECT_RING_SIZE_PER_FRAME;
+    DrawCommandInfo* commandInfos = nullptr;
+    CullObject* cullObjects = nullptr;
+    if (culling)
+    {
+        commandInfos = reinterpret_cast<DrawCommandInfo*>(
+            static_cast<char*>(m_drawCommandInfoBuffer.m_allocation.mappedData) +
+            m_currentFrameIndex * AlignStorageOffset(sizeof(DrawCommandInfo) * MAX_INDIRECT_COMMANDS_PER_FRAME));
+        cullObjects = reinterpret_cast<CullObject*>(
+            static_cast<char*>(m_cullObjectBuffer.m_allocation.mappedData) +
+            m_currentFrameIndex * AlignStorageOffset(sizeof(CullObject) * MAX_RING_INSTANCES_PER_FRAME));
+    }
+
+    // Sorted, so state only changes between runs of draws that share it. Draws
+    // in between state changes go into the indirect ring and out as one batch.
+    // Textures are picked per instance from the bindless table, every batch shares the frame's set
+    const VkDescriptorSet frameSet = m_descriptorSets[m_currentFrameIndex];
+    const Texture2D* usedAlbedo = nullptr;
+    auto markAlbedoUsed = [&](const Texture2D* albedo) {
+        if (!albedo || albedo == usedAlbedo) return;
+        albedo->MarkUsed(m_frameCount);
+        retained_draws.textures.push_back(albedo);
+        usedAlbedo = albedo;
+    };
+    const VertexArray* vertexInputArray = nullptr;
+    const VertexInputLayout* vertexInput = nullptr;
+    const void* boundUniformData = nullptr;
+    uint32_t dynamicOffset = 0;
+    for (uint32_t drawIndex = 0; drawIndex < m_drawOrder.size(); drawIndex++)
+    {
+        const RenderResources& draw = render_list[m_drawOrder[drawIndex].index];
+        const GraphicsPipeline* pipeline = _GetDrawPipeline(draw);
+        const VertexArray* vertexArray = draw.vertexArray;
+        MLC_ASSERT(draw.indexOffset.size() == draw.indexCount.size() &&
+                   (draw.vertexOffset.empty() || draw.vertexOffset.size() == draw.indexCount.size()),
+                   "Submesh ranges don't match up.");
+
+        // Draws of the same vertex array are next to each other, only look it up when that changes
+        if (m_vertexInputDynamicStateSupported && vertexArray != vertexInputArray)
+        {
+            vertexInput = _GetVertexInputLayout(vertexArray);
+            vertexInputArray = vertexArray;
+        }
+
+        // Draws sharing uniform data share its copy in the ring
+        if (draw.uniformData && draw.uniformData != boundUniformData)
+        {
+            dynamicOffset = PushUniformData(draw.uniformData, draw.uniformSize);
+            retained_draws.uniforms.push_back(RetainedUniform {
+                .data = draw.uniformData,
+                .size = draw.uniformSize,
+                .offset = dynamicOffset
+            });
+            boundUniformData = draw.uniformData;
+        }
+
+        uint32_t submeshCount = draw.indexCount.empty() ? 1 : static_cast<uint32_t>(draw.indexCount.size());
+        VkDeviceSize commandsOffset;
+        VkDrawIndexedIndirectCommand* commands = static_cast<VkDrawIndexedIndirectCommand*>(
+            _AllocateIndirectData(sizeof(VkDrawIndexedIndirectCommand) * submeshCount, commandsOffset));
+        uint32_t firstCommand = static_cast<uint32_t>(
+            (commandsOffset - indirectFrameOffset) / sizeof(VkDrawIndexedIndirectCommand));
+
+        uint32_t instanceCount;
+        uint32_t firstInstance;
+        VkBuffer instanceBuffer;
+        VkDeviceSize instanceBufferOffset;
+        bool culledRun = false;
+        if (draw.instanceBuffer)
+        {
+            instanceCount = draw.instanceBuffer->GetInstanceCount();
+            firstInstance = 0;
+            instanceBuffer = draw.instanceBuffer->GetBuffer().m_handle;
+            instanceBufferOffset = 0;
+            // Nothing per draw reaches the shader, the instances carry their own albedoIndex.
+            // The material's albedo is only kept loaded for them.
+            markAlbedoUsed(draw.material.GetAlbedo());
+        }
+        else
+        {
+            // Sorting put entries with the same vertex array next to each other
+            uint32_t runEnd = drawIndex + 1;
+            while (runEnd < m_drawOrder.size())
+            {
+                const RenderResources& next = render_list[m_drawOrder[runEnd].index];
+                if (_GetDrawPipeline(next) != pipeline ||
+                    next.vertexArray != draw.vertexArray ||
+                    next.uniformData != draw.uniformData ||
+                    next.pushConstantData != draw.pushConstantData ||
+                    next.instanceBuffer ||
+                    next.indexOffset != draw.indexOffset ||
+                    next.indexCount != draw.indexCount ||
+                    next.vertexOffset != draw.vertexOffset)
+                {
+                    break;
+                }
+                runEnd++;
+            }
+
+            instanceCount = runEnd - drawIndex;
+            InstanceData* instances = _AllocateInstances(instanceCount, firstInstance);
+            for (uint32_t i = 0; i < instanceCount; i++)
+            {
+                const RenderResources& entry = render_list[m_drawOrder[drawIndex + i].index];
+                const Texture2D* albedo = entry.material.GetAlbedo();
+                markAlbedoUsed(albedo);
+                instances[i] = entry.instance;
+                instances[i].albedoIndex = albedo ? albedo->GetBindlessIndex() : 0;
+                if (culling)
+                {
+                    // Instances are read from the ring and the visible ones written to the same slots of the culled buffer
+                    cullObjects[m_cullObjectCount++] = CullObject {
+                        .sphere = entry.boundingSphere,
+                        .command = firstCommand,
+                        .srcInstance = firstInstance + i,
+                        .dstFirstInstance = firstInstance,
+                        .padding = 0
+                    };
+                }
+            }
+            drawIndex = runEnd - 1;
+
+            culledRun = culling;
+            instanceBuffer = culling ? m_culledInstanceBuffer.m_handle : m_instanceRingBuffer.m_handle;
+            instanceBufferOffset = m_currentFrameIndex * INSTANCE_RING_SIZE_PER_FRAME;
+            if (!m_drawIndirectFirstInstanceSupported)
+            {
+                // Indirect firstInstance has to be 0, move the binding instead
+                instanceBufferOffset += sizeof(InstanceData) * firstInstance;
+                firstInstance = 0;
+            }
+        }
+
+        // Without a range in the pipeline layout there's nothing to push
+        const void* pushConstantData = pipeline->m_pushConstantSize > 0 ? draw.pushConstantData : nullptr;
+        if (m_drawBatches.empty() ||
+            m_drawBatches.back().pipeline != pipeline ||
+            m_drawBatches.back().vertexInput != vertexInput ||
+            m_drawBatches.back().descriptorSet != frameSet ||
+            m_drawBatches.back().dynamicOffset != dynamicOffset ||
+            m_drawBatches.back().instanceBuffer != instanceBuffer ||
+            m_drawBatches.back().instanceBufferOffset != instanceBufferOffset ||
+            m_drawBatches.back().pushConstantData != pushConstantData)
+        {
+            MLC_ASSERT(!culling || m_drawBatches.size() < MAX_DRAW_BATCHES_PER_FRAME,
+                       "Too many draw batches in one frame, raise MAX_DRAW_BATCHES_PER_FRAME.");
+            m_drawBatches.push_back(DrawBatch {
+                .pipeline = pipeline,
+                .vertexInput = vertexInput,
+                .descriptorSet = frameSet,
+                .dynamicOffset = dynamicOffset,
+                .instanceBuffer = instanceBuffer,
+                .instanceBufferOffset = instanceBufferOffset,
+                .firstCommand = firstCommand,
+                .commandCount = 0,
+                .pushConstantData = pushConstantData
+            });
+        }
+        DrawBatch& batch = m_drawBatches.back();
+
+        for (uint32_t submesh = 0; submesh < submeshCount; submesh++)
+        {
+            bool wholeArray = draw.indexCount.empty();
+            commands[submesh] = VkDrawIndexedIndirectCommand {
+                .indexCount = wholeArray ? vertexArray->GetIndicesCount() : draw.indexCount[submesh],
+                .instanceCount = culledRun ? 0 : instanceCount,  // culling counts the visible ones
+                .firstIndex = vertexArray->GetFirstIndex() + (wholeArray ? 0 : draw.indexOffset[submesh]),
+                .vertexOffset = static_cast<int32_t>(vertexArray->GetFirstVertex()) +
+                                (draw.vertexOffset.empty() ? 0 : draw.vertexOffset[submesh]),
+                .firstInstance = firstInstance
+            };
+            if (culling)
+            {
+                commandInfos[firstCommand + submesh] = DrawCommandInfo {
+                    .batch = static_cast<uint32_t>(m_drawBatches.size() - 1),
+                    .batchFirstCommand = batch.firstCommand,
+                    .countCommand = culledRun ? firstCommand : firstCommand + submesh
+                };
+            }
+        }
+        batch.commandCount += submeshCount;
+        m_drawCommandCount += submeshCount;
+    }
+
+    // Counts are written up front, batches may be recorded on several threads and the ring isn't thread safe
+    if (!culling && m_drawIndirectCountSupported && !m_drawBatches.empty())
+    {
+        uint32_t* counts = static_cast<uint32_t*>(
+            _AllocateIndirectData(sizeof(uint32_t) * m_drawBatches.size(), m_drawCountsOffset));
+        for (uint32_t batchIndex = 0; batchIndex < m_drawBatches.size(); batchIndex++)
+        {
+            counts[batchIndex] = m_drawBatches[batchIndex].commandCount;
+        }
+    }
+}
+
+void VulkanManager::_SortDraws(const std::vector<RenderResources>& render_list, bool cpu_culling) const
+{
+    if (cpu_culling)
+    {
+        // Spheres go into the culler's arrays in instance space, same as the GPU path tests them
+        m_frustumCuller.Clear();
+        m_frustumCuller.Reserve(static_cast<uint32_t>(render_list.size()));
+        for (const RenderResources& draw : render_list)
+        {
+            if (draw.instanceBuffer || draw.boundingSphere.w <= 0.0f)
+            {
+                m_frustumCuller.Add(glm::vec4(0.0f));
+                continue;
+            }
+
+            const glm::mat4& transform = draw.instance.transform;
+            glm::vec4 center = transform * glm::vec4(glm::vec3(draw.boundingSphere), 1.0f);
+            float scale = glm::max(glm::length(glm::vec3(transform[0])),
+                                   glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+            m_frustumCuller.Add(glm::vec4(glm::vec3(center), draw.boundingSphere.w * scale));
+        }
+        m_frustumCuller.Cull(m_cullingPlanes, m_drawVisibility);
+    }
+
+    // Dense per-frame ids keep the key's fields small, each field counts on its own
+    for (std::unordered_map<const void*, uint32_t>& sortIds : m_drawSortIds)
+    {
+        sortIds.clear();
+    }
+    auto getSortId = [this](uint32_t field, const void* state, uint32_t bits) -> uint64_t {
+        std::unordered_map<const void*, uint32_t>& sortIds = m_drawSortIds[field];
+        uint32_t id = sortIds.try_emplace(state, static_cast<uint32_t>(sortIds.size())).first->second;
+        MLC_ASSERT(id < (1u << bits), "Too many distinct draw states in one frame for the sort key.");
+        return id & ((1u << bits) - 1);  // only ever costs batching, never spills into the next field
+    };
+
+    m_drawOrder.clear();
+    for (uint32_t i = 0; i < render_list.size(); i++)
+    {
+        const RenderResources& draw = render_list[i];
+        if (!draw.vertexArray || !_GetDrawPipeline(draw)) continue;
+        if (cpu_culling && !m_drawVisibility[i]) continue;
+
+        // [63..56] pipeline | [55..40] vertex array | [39..24] material | [23..0] depth
+        // Textures don't split instanced draws, they only keep the same ones together
+        uint64_t pipelineId = getSortId(0, _GetDrawPipeline(draw), 8);
+        uint64_t vertexArrayId = getSortId(1, draw.vertexArray, 16);
+        uint64_t materialId = getSortId(2, draw.material.GetAlbedo(), 16);
+        uint64_t depth = static_cast<uint64_t>(std::clamp(draw.depth, 0.0f, 1.0f) * 0xFFFFFF);
+        m_drawOrder.push_back(SortItem {
+            .key = (pipelineId << 56) | (vertexArrayId << 40) | (materialId << 24) | depth,
+            .index = i
+        });
+    }
+
+    RadixSort(m_drawOrder, m_drawOrderScratch);
+}
+
+const GraphicsPipeline* VulkanManager::_GetDrawPipeline(const RenderResources& draw) const
+{
+    // Pipelines only ever become ready, one that was seen ready earlier in the frame stays that way.
+    // The draw state hash goes through here too, so the frame is rebuilt once it's done.
+    const GraphicsPipeline* pipeline = draw.pipeline ? draw.pipeline : m_defaultPipeline;
+    if (pipeline && !pipeline->IsReady())
+    {
+        pipeline = m_fallbackPipeline && m_fallbackPipeline->IsReady() ? m_fallbackPipeline : nullptr;
+    }
+    return pipeline;
+}
+
+const VulkanManager::VertexInputLayout* VulkanManager::_GetVertexInputLayout(const VertexArray* vertex_array) const
+{
+    std::vector<VkVertexInputBindingDescription> bindingDescs = vertex_array->GetBindingDescriptions();
+    std::vector<VkVertexInputAttributeDescription> attribDescs = vertex_array->GetAttribDescriptions();
+
+    // Arrays with the same layout share it, so batches can tell it hasn't changed by the pointer
+    uint64_t hash = 0;
+    HashCombine(hash, bindingDescs.size());
+    HashBytes(hash, bindingDescs.data(), sizeof(VkVertexInputBindingDescription) * bindingDescs.size());
+    HashCombine(hash, attribDescs.size());
+    HashBytes(hash, attribDescs.data(), sizeof(VkVertexInputAttributeDescription) * attribDescs.size());
+
+    auto [first, last] = m_vertexInputLayouts.equal_range(hash);
+    for (auto it = first; it != last; it++)
+    {
+        if (SameBytes(it->second.bindingDescs, bindingDescs) && SameBytes(it->second.attribDescs, attribDescs))
+        {
+            return &it->second;
+        }
+    }
+
+    VertexInputLayout& layout = m_vertexInputLayouts.emplace(hash, VertexInputLayout {})->second;
+    for (const VkVertexInputBindingDescription& bindingDesc : bindingDescs)
+    {
+        layout.bindings.push_back(VkVertexInputBindingDescription2EXT {
+            .sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT,
+            .pNext = VK_NULL_HANDLE,
+            .binding = bindingDesc.binding,
+            .stride = bindingDesc.stride,
+            .inputRate = bindingDesc.inputRate,
+            .divisor = 1
+        });
+    }
+    for (const VkVertexInputAttributeDescription& attribDesc : attribDescs)
+    {
+        layout.attributes.push_back(VkVertexInputAttributeDescription2EXT {
+            .sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT,
+            .pNext = VK_NULL_HANDLE,
+            .location = attribDesc.location,
+            .binding = attribDesc.binding,
+            .format = attribDesc.format,
+            .offset = attribDesc.offset
+        });
+    }
+    layout.bindingDescs = std::move(bindingDescs);
+    layout.attribDescs = std::move(attribDescs);
+    return &layout;
+}
+
+void VulkanManager::_WriteUniformRingDescriptor(VkDescriptorSet descriptor_set, uint32_t frame_index) const
+{
+    VkDescriptorBufferInfo bufferInfo {
+        .buffer = m_uniformRingBuffer.m_handle,
+        .offset = frame_index * UNIFORM_RING_SIZE_PER_FRAME,
+        .range = m_uniformRingRange
+    };
+    VkWriteDescriptorSet descriptorWrite {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = VK_NULL_HANDLE,
+        .dstSet = descriptor_set,
+        .dstBinding = m_uniformRingBinding,
+        .dstArrayElement = 0,  // It is possible to update multiple descriptors at once in an array
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        .pImageInfo = VK_NULL_HANDLE,
+        .pBufferInfo = &bufferInfo,
+        .pTexelBufferView = VK_NULL_HANDLE
+    };
+
+    vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void VulkanManager::_WriteBindlessTexture(uint32_t index, const Image2DViewer& viewer) const
+{
+    VkDescriptorImageInfo imageInfo {
+        .sampler = viewer.m_sampler,
+        .imageView = viewer.m_imageView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+    VkWriteDescriptorSet descriptorWrite {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = VK_NULL_HANDLE,
+        .dstSet = m_bindlessTextureSet,
+        .dstBinding = 0,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &imageInfo,
+        .pBufferInfo = VK_NULL_HANDLE,
+        .pTexelBufferView = VK_NULL_HANDLE
+    };
+
+    vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
+
+VkFormat VulkanManager::_FindSupportedFormat(const std::vector<VkFormat>& candidates,
+                                         VkImageTiling tiling,
+                                         VkFormatFeatureFlags features) const
+{
+    for (VkFormat format : candidates)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &properties);
+
+        if (tiling == VK_IMAGE_TILING_LINEAR && (properties.linearTilingFeatures & features) == features)
+        {
+            return format;
+        }
+        else if (tiling == VK_IMAGE_TILING_OPTIMAL && (properties.optimalTilingFeatures & features) == features)
+        {
+            return format;
+        }
+    }
+    MLC_ASSERT(false, "");
+    MLC_ERROR("Failed to find supported format, returning VK_FORMAT_D32_SFLOAT.");
+    return candidates.at(0);
+}
+
+VkFormat VulkanManager::_FindDepthFormat() const
+{
+    return _FindSupportedFormat(
+        { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+    );
+}
+
+bool VulkanManager::_HasStencilComponent(VkFormat format) const
+{
+    return (format == VK_FORMAT_D32_SFLOAT_S8_UINT) || (format == VK_FORMAT_D24_UNORM_S8_UINT);
+}
+
+void VulkanManager::_CreateDepthResources()
+{
+    VkFormat depthFormat = _FindDepthFormat();
+
+    // Occlusion culling builds its Hi-Z pyramid out of the depth attachment
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_physicalDevice, depthFormat, &formatProperties);
+    m_depthSampled = formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+    AllocateImage2D(m_depthImage,
+                    m_swapChainExtent.width,
+                    m_swapChainExtent.height,
+                    depthFormat,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (m_depthSampled ? VK_IMAGE_USAGE_SAMPLED_BIT : 0),
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_depthImageView = _CreateImageView(m_depthImage.m_handle, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+    TransitionImageLayout(m_depthImage,
+                          depthFormat,
+                          VK_IMAGE_LAYOUT_UNDEFINED,
+                          VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+}
+
+void VulkanManager::_CreateSyncObjects()
+{
+    m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    m_renderFinishedSemaphores.resize(m_swapChainImages.size());
+    m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0  
+    };
+    VkFenceCreateInfo fenceCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT
+    };
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        bool result;
+        result = vkCreateSemaphore(m_device,
+                                   &semaphoreCreateInfo,
+                                   MLC_VULKAN_ALLOCATOR,
+                                   &m_imageAvailableSemaphores[i]) == VK_SUCCESS
+              && vkCreateFence(m_device,
+                               &fenceCreateInfo,
+                               MLC_VULKAN_ALLOCATOR,
+                               &m_inFlightFences[i]) == VK_SUCCESS;
+        MLC_ASSERT(result, "Failed to create sync objects.");
+    }
+    for (uint32_t i = 0; i < m_swapChainImages.size(); i++)
+    {
+        VkResult result = vkCreateSemaphore(m_device,
+                                &semaphoreCreateInfo,
+                                MLC_VULKAN_ALLOCATOR,
+                                &m_renderFinishedSemaphores[i]);
+        MLC_ASSERT(result == VK_SUCCESS, "Failed to create sync objects.");
+    }
+}
+
+void VulkanManager::_CreateStagingBuffer()
+{
+    AllocateBuffer(m_stagingBuffer,
+                   STAGING_BUFFER_SIZE,
+                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_stagingRing = RingAllocator(STAGING_BUFFER_SIZE);
+}
+
+void VulkanManager::_DestroyStagingBuffer()
+{
+    for (auto& [serial, buffer] : m_stagingOverflowBuffers)
+    {
+        DeallocateBuffer(buffer);
+    }
+    m_stagingOverflowBuffers.clear();
+    DeallocateBuffer(m_stagingBuffer);
+}
+
+void VulkanManager::_CreateGeometryArena()
+{
+    AllocateBuffer(m_geometryVertexBuffer,
+                   sizeof(Vertex) * GEOMETRY_ARENA_VERTEX_CAPACITY,
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    AllocateBuffer(m_geometryIndexBuffer,
+                   sizeof(uint16_t) * GEOMETRY_ARENA_INDEX_CAPACITY,
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_geometryVertexRanges = FreeListAllocator(GEOMETRY_ARENA_VERTEX_CAPACITY);
+    m_geometryIndexRanges = FreeListAllocator(GEOMETRY_ARENA_INDEX_CAPACITY);
+}
+
+void VulkanManager::_DestroyGeometryArena()
+{
+    if (!m_geometryVertexRanges.IsEmpty() || !m_geometryIndexRanges.IsEmpty())
+    {
+        MLC_WARN("Geometry arena still has {} vertices and {} indices in use.",
+                 m_geometryVertexRanges.GetUsedSize(),
+                 m_geometryIndexRanges.GetUsedSize());
+    }
+    DeallocateBuffer(m_geometryVertexBuffer);
+    DeallocateBuffer(m_geometryIndexBuffer);
+    m_geometryVertexRanges = FreeListAllocator();
+    m_geometryIndexRanges = FreeListAllocator();
+}
+
+void VulkanManager::_CreateUniformRing()
+{
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+    m_uniformRingAlignment = std::max<VkDeviceSize>(deviceProperties.limits.minUniformBufferOffsetAlignment, 1);
+
+    AllocateBuffer(m_uniformRingBuffer,
+                   UNIFORM_RING_SIZE_PER_FRAME * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_uniformRingHead = 0;
+}
+
+void VulkanManager::_DestroyUniformRing()
+{
+    DeallocateBuffer(m_uniformRingBuffer);
+    m_uniformRingRange = 0;
+}
+
+void VulkanManager::_CreateInstanceRing()
+{
+    AllocateBuffer(m_instanceRingBuffer,
+                   INSTANCE_RING_SIZE_PER_FRAME * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // culling reads it
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_instanceRingHead = 0;
+}
+
+void VulkanManager::_DestroyInstanceRing()
+{
+    DeallocateBuffer(m_instanceRingBuffer);
+}
+
+InstanceData* VulkanManager::_AllocateInstances(uint32_t count, uint32_t& first_instance) const
+{
+    MLC_ASSERT(sizeof(InstanceData) * (m_instanceRingHead + count) <= INSTANCE_RING_SIZE_PER_FRAME,
+               "Instance ring is full, raise INSTANCE_RING_SIZE_PER_FRAME.");
+
+    first_instance = m_instanceRingHead;
+    m_instanceRingHead += count;
+
+    InstanceData* frameInstances = reinterpret_cast<InstanceData*>(
+        static_cast<char*>(m_instanceRingBuffer.m_allocation.mappedData) +
+        m_currentFrameIndex * INSTANCE_RING_SIZE_PER_FRAME);
+    return frameInstances + first_instance;
+}
+
+void VulkanManager::_CreateIndirectRing()
+{
+    AllocateBuffer(m_indirectRingBuffer,
+                   INDIRECT_RING_SIZE_PER_FRAME * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,  // culling counts into it
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    m_indirectRingHead = 0;
+}
+
+void VulkanManager::_DestroyIndirectRing()
+{
+    DeallocateBuffer(m_indirectRingBuffer);
+}
+
+void* VulkanManager::_AllocateIndirectData(VkDeviceSize size, VkDeviceSize& offset) const
+{
+    MLC_ASSERT(m_indirectRingHead + size <= INDIRECT_RING_SIZE_PER_FRAME,
+               "Indirect ring is full, raise INDIRECT_RING_SIZE_PER_FRAME.");
+
+    offset = m_currentFrameIndex * INDIRECT_RING_SIZE_PER_FRAME + m_indirectRingHead;
+    m_indirectRingHead += size;
+
+    return static_cast<char*>(m_indirectRingBuffer.m_allocation.mappedData) + offset;
+}
+
+void VulkanManager::_CreateBindlessTextures()
+{
+    VkPhysicalDeviceVulkan12Properties vulkan12Properties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES,
+        .pNext = VK_NULL_HANDLE
+    };
+    VkPhysicalDeviceProperties2 properties {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &vulkan12Properties
+    };
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
+    // Combined image samplers count as both
+    m_bindlessTextureCapacity = std::min({ MAX_BINDLESS_TEXTURES,
+                                           vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                           vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                           vulkan12Properties.maxDescriptorSetUpdateAfterBindSamplers,
+                                           vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages });
+    MLC_INFO("Bindless texture table: {} slots", m_bindlessTextureCapacity);
+
+    // Partially bound, slots nothing was loaded into yet are never read
+    std::vector<VkDescriptorSetLayoutBinding> bindings {
+        VkDescriptorSetLayoutBinding {
+            .binding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = m_bindlessTextureCapacity,
+            .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .pImmutableSamplers = nullptr
+        }
+    };
+    std::vector<VkDescriptorBindingFlags> bindingFlags {
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+    };
+    m_bindlessTextureLayout = m_descriptorSetLayoutCache.GetLayout(bindings,
+                                                                   VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+                                                                   bindingFlags);
+
+    VkDescriptorPoolSize poolSize {
+        .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = m_bindlessTextureCapacity
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize
+    };
+    VkResult result = vkCreateDescriptorPool(m_device, &poolCreateInfo, MLC_VULKAN_ALLOCATOR, &m_bindlessTexturePool);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create bindless texture descriptor pool.");
+
+    VkDescriptorSetAllocateInfo allocateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .descriptorPool = m_bindlessTexturePool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &m_bindlessTextureLayout
+    };
+    result = vkAllocateDescriptorSets(m_device, &allocateInfo, &m_bindlessTextureSet);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate bindless texture descriptor set.");
+}
+
+void VulkanManager::_DestroyBindlessTextures()
+{
+    vkDestroyDescriptorPool(m_device, m_bindlessTexturePool, MLC_VULKAN_ALLOCATOR);
+    m_bindlessTexturePool = VK_NULL_HANDLE;
+    m_bindlessTextureSet = VK_NULL_HANDLE;
+    m_bindlessTextureLayout = VK_NULL_HANDLE;  // destroyed with the layout cache
+    m_bindlessTextureCount = 0;
+    m_freeBindlessTextures.clear();
+}
+
+void VulkanManager::_DrawIndirectBatch(VkCommandBuffer command_buffer,
+                                       uint32_t batch_index,
+                                       const GPUBuffer* culled_commands,
+                                       const GPUBuffer* draw_counts) const
+{
+    const DrawBatch& batch = m_drawBatches[batch_index];
+    VkDeviceSize firstCommandOffset = m_currentFrameIndex * INDIRECT_RING_SIZE_PER_FRAME +
+                                      batch.firstCommand * sizeof(VkDrawIndexedIndirectCommand);
+
+    if (culled_commands)
+    {
+        // Survivors were compacted to the front of the batch's range, the count is whatever culling left
+        vkCmdDrawIndexedIndirectCount(command_buffer,
+                                      culled_commands->m_handle,
+                                      firstCommandOffset,
+                                      draw_counts->m_handle,
+                                      m_currentFrameIndex * AlignStorageOffset(sizeof(uint32_t) * MAX_DRAW_BATCHES_PER_FRAME) +
+                                      batch_index * sizeof(uint32_t),
+                                      batch.commandCount,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else if (m_drawIndirectCountSupported)
+    {
+        vkCmdDrawIndexedIndirectCount(command_buffer,
+                                      m_indirectRingBuffer.m_handle,
+                                      firstCommandOffset,
+                                      m_indirectRingBuffer.m_handle,
+                                      m_drawCountsOffset + batch_index * sizeof(uint32_t),
+                                      batch.commandCount,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else if (m_multiDrawIndirectSupported)
+    {
+        vkCmdDrawIndexedIndirect(command_buffer,
+                                 m_indirectRingBuffer.m_handle,
+                                 firstCommandOffset,
+                                 batch.commandCount,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    }
+    else
+    {
+        // drawCount can only be 0 or 1 without multiDrawIndirect
+        for (uint32_t i = 0; i < batch.commandCount; i++)
+        {
+            vkCmdDrawIndexedIndirect(command_buffer,
+                                     m_indirectRingBuffer.m_handle,
+                                     firstCommandOffset + i * sizeof(VkDrawIndexedIndirectCommand),
+                                     1,
+                                     sizeof(VkDrawIndexedIndirectCommand));
+        }
+    }
+}
+
+void VulkanManager::_CreateCulling()
+{
+    if (!m_drawIndirectCountSupported)
+    {
+        MLC_WARN("No drawIndirectCount, GPU culling is disabled.");
+        return;
+    }
+
+    std::vector<char> bytecode;
+    File shaderFile("Engine/resources/shaders/bin/cull_comp.spv");
+    if (!ReadShaderBytecode(shaderFile, bytecode))
+    {
+        MLC_WARN("\"{}\" isn't compiled, GPU culling is disabled.", shaderFile.GetPath());
+        return;
+    }
+
+    // ----- Buffers -----
+
+    AllocateBuffer(m_cullObjectBuffer,
+                   AlignStorageOffset(sizeof(CullObject) * MAX_RING_INSTANCES_PER_FRAME) * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    AllocateBuffer(m_drawCommandInfoBuffer,
+                   AlignStorageOffset(sizeof(DrawCommandInfo) * MAX_INDIRECT_COMMANDS_PER_FRAME) * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    AllocateBuffer(m_culledCommandBuffer,
+                   INDIRECT_RING_SIZE_PER_FRAME * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    AllocateBuffer(m_drawCountBuffer,
+                   AlignStorageOffset(sizeof(uint32_t) * MAX_DRAW_BATCHES_PER_FRAME) * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    AllocateBuffer(m_culledInstanceBuffer,
+                   INSTANCE_RING_SIZE_PER_FRAME * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    AllocateBuffer(m_cullFrustumBuffer,
+                   AlignStorageOffset(sizeof(glm::mat4)) * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    // The shader always has the late bindings, they're small enough to keep around without occlusion culling
+    AllocateBuffer(m_lateObjectBuffer,
+                   AlignStorageOffset(sizeof(uint32_t) * (1 + MAX_RING_INSTANCES_PER_FRAME)) * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    AllocateBuffer(m_lateInstanceCountBuffer,
+                   AlignStorageOffset(sizeof(uint32_t) * MAX_INDIRECT_COMMANDS_PER_FRAME) * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    AllocateBuffer(m_lateCulledCommandBuffer,
+                   INDIRECT_RING_SIZE_PER_FRAME * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    AllocateBuffer(m_lateDrawCountBuffer,
+                   AlignStorageOffset(sizeof(uint32_t) * MAX_DRAW_BATCHES_PER_FRAME) * MAX_FRAMES_IN_FLIGHT,
+                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    // ----- Descriptors -----
+
+    // Same order as the bindings in cull.comp, the pyramid comes after them
+    const std::array<std::pair<const GPUBuffer*, VkDeviceSize>, 12> bindingBuffers {
+        std::make_pair(&m_instanceRingBuffer, INSTANCE_RING_SIZE_PER_FRAME),
+        std::make_pair(&m_cullObjectBuffer, AlignStorageOffset(sizeof(CullObject) * MAX_RING_INSTANCES_PER_FRAME)),
+        std::make_pair(&m_indirectRingBuffer, INDIRECT_RING_SIZE_PER_FRAME),
+        std::make_pair(&m_drawCommandInfoBuffer, AlignStorageOffset(sizeof(DrawCommandInfo) * MAX_INDIRECT_COMMANDS_PER_FRAME)),
+        std::make_pair(&m_culledCommandBuffer, INDIRECT_RING_SIZE_PER_FRAME),
+        std::make_pair(&m_drawCountBuffer, AlignStorageOffset(sizeof(uint32_t) * MAX_DRAW_BATCHES_PER_FRAME)),
+        std::make_pair(&m_culledInstanceBuffer, INSTANCE_RING_SIZE_PER_FRAME),
+        std::make_pair(&m_lateObjectBuffer, AlignStorageOffset(sizeof(uint32_t) * (1 + MAX_RING_INSTANCES_PER_FRAME))),
+        std::make_pair(&m_lateInstanceCountBuffer, AlignStorageOffset(sizeof(uint32_t) * MAX_INDIRECT_COMMANDS_PER_FRAME)),
+        std::make_pair(&m_lateCulledCommandBuffer, INDIRECT_RING_SIZE_PER_FRAME),
+        std::make_pair(&m_lateDrawCountBuffer, AlignStorageOffset(sizeof(uint32_t) * MAX_DRAW_BATCHES_PER_FRAME)),
+        std::make_pair(&m_cullFrustumBuffer, AlignStorageOffset(sizeof(glm::mat4)))
+    };
+    const uint32_t hiZBinding = static_cast<uint32_t>(bindingBuffers.size());
+
+    std::array<VkDescriptorSetLayoutBinding, bindingBuffers.size() + 1> layoutBindings;
+    for (uint32_t binding = 0; binding < layoutBindings.size(); binding++)
+    {
+        layoutBindings[binding] = VkDescriptorSetLayoutBinding {
+            .binding = binding,
+            .descriptorType = binding == hiZBinding ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                                    : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr
+        };
+    }
+    m_cullDescriptorSetLayout = m_descriptorSetLayoutCache.GetLayout({ layoutBindings.begin(), layoutBindings.end() });
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes {
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = static_cast<uint32_t>(bindingBuffers.size()) * MAX_FRAMES_IN_FLIGHT
+        },
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = MAX_FRAMES_IN_FLIGHT
+        }
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .maxSets = MAX_FRAMES_IN_FLIGHT,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data()
+    };
+    VkResult result = vkCreateDescriptorPool(m_device, &poolCreateInfo, MLC_VULKAN_ALLOCATOR, &m_cullDescriptorPool);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create culling descriptor pool.");
+
+    std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> setLayouts;
+    setLayouts.fill(m_cullDescriptorSetLayout);
+    VkDescriptorSetAllocateInfo allocateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .descriptorPool = m_cullDescriptorPool,
+        .descriptorSetCount = MAX_FRAMES_IN_FLIGHT,
+        .pSetLayouts = setLayouts.data()
+    };
+    result = vkAllocateDescriptorSets(m_device, &allocateInfo, m_cullDescriptorSets.data());
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate culling descriptor sets.");
+
+    // Every frame's set sees that frame's part of each buffer
+    for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+    {
+        std::array<VkDescriptorBufferInfo, bindingBuffers.size()> bufferInfos;
+        std::array<VkWriteDescriptorSet, bindingBuffers.size()> descriptorWrites;
+        for (uint32_t binding = 0; binding < bindingBuffers.size(); binding++)
+        {
+            bufferInfos[binding] = VkDescriptorBufferInfo {
+                .buffer = bindingBuffers[binding].first->m_handle,
+                .offset = frame * bindingBuffers[binding].second,
+                .range = bindingBuffers[binding].second
+            };
+            descriptorWrites[binding] = VkWriteDescriptorSet {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = VK_NULL_HANDLE,
+                .dstSet = m_cullDescriptorSets[frame],
+                .dstBinding = binding,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pImageInfo = VK_NULL_HANDLE,
+                .pBufferInfo = &bufferInfos[binding],
+                .pTexelBufferView = VK_NULL_HANDLE
+            };
+        }
+        vkUpdateDescriptorSets(m_device,
+                               static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(),
+                               0,
+                               nullptr);
+    }
+
+    // ----- Compute Pipeline -----
+
+    VkPushConstantRange pushConstantRange {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(CullParams)
+    };
+    static_assert(sizeof(CullParams) <= MAX_PUSH_CONSTANTS_SIZE, "CullParams size larger than 128 bytes.");
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_cullDescriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    result = vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, MLC_VULKAN_ALLOCATOR, &m_cullPipelineLayout);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create culling pipeline layout.");
+
+    m_cullPipeline = _CreateComputePipeline(m_cullPipelineLayout, bytecode);
+
+    // Nearest, the pyramid is read texel by texel
+    VkSamplerCreateInfo samplerCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias = 0.0f,
+        .anisotropyEnable = VK_FALSE,
+        .maxAnisotropy = 1.0f,
+        .compareEnable = VK_FALSE,
+        .compareOp = VK_COMPARE_OP_ALWAYS,
+        .minLod = 0.0f,
+        .maxLod = VK_LOD_CLAMP_NONE,
+        .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+    result = vkCreateSampler(m_device, &samplerCreateInfo, MLC_VULKAN_ALLOCATOR, &m_hiZSampler);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create Hi-Z sampler.");
+
+    _CreateHiZPipeline();
+    _CreateHiZResources();
+
+    m_cullingSupported = true;
+}
+
+void VulkanManager::_DestroyCulling()
+{
+    if (!m_cullingSupported) return;
+
+    _DestroyHiZResources();
+    if (m_occlusionCullingSupported)
+    {
+        vkDestroyPipeline(m_device, m_hiZPipeline, MLC_VULKAN_ALLOCATOR);
+        m_hiZPipeline = VK_NULL_HANDLE;
+        vkDestroyPipelineLayout(m_device, m_hiZPipelineLayout, MLC_VULKAN_ALLOCATOR);
+        m_hiZPipelineLayout = VK_NULL_HANDLE;
+        vkDestroyDescriptorPool(m_device, m_hiZDescriptorPool, MLC_VULKAN_ALLOCATOR);
+        m_hiZDescriptorPool = VK_NULL_HANDLE;
+        m_hiZDescriptorSetLayout = VK_NULL_HANDLE;
+        m_occlusionCullingSupported = false;
+    }
+    vkDestroySampler(m_device, m_hiZSampler, MLC_VULKAN_ALLOCATOR);
+    m_hiZSampler = VK_NULL_HANDLE;
+
+    vkDestroyPipeline(m_device, m_cullPipeline, MLC_VULKAN_ALLOCATOR);
+    m_cullPipeline = VK_NULL_HANDLE;
+    vkDestroyPipelineLayout(m_device, m_cullPipelineLayout, MLC_VULKAN_ALLOCATOR);
+    m_cullPipelineLayout = VK_NULL_HANDLE;
+    vkDestroyDescriptorPool(m_device, m_cullDescriptorPool, MLC_VULKAN_ALLOCATOR);
+    m_cullDescriptorPool = VK_NULL_HANDLE;
+    m_cullDescriptorSetLayout = VK_NULL_HANDLE;
+    DeallocateBuffer(m_cullObjectBuffer);
+    DeallocateBuffer(m_drawCommandInfoBuffer);
+    DeallocateBuffer(m_culledCommandBuffer);
+    DeallocateBuffer(m_drawCountBuffer);
+    DeallocateBuffer(m_culledInstanceBuffer);
+    DeallocateBuffer(m_cullFrustumBuffer);
+    DeallocateBuffer(m_lateObjectBuffer);
+    DeallocateBuffer(m_lateInstanceCountBuffer);
+    DeallocateBuffer(m_lateCulledCommandBuffer);
+    DeallocateBuffer(m_lateDrawCountBuffer);
+    m_cullingSupported = false;
+}
+
+VkPipeline VulkanManager::_CreateComputePipeline(VkPipelineLayout pipeline_layout, const std::vector<char>& bytecode) const
+{
+    VkShaderModule shaderModule;
+    CreateShaderModule(shaderModule, bytecode);
+    VkComputePipelineCreateInfo pipelineCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .stage = VkPipelineShaderStageCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = VK_NULL_HANDLE,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shaderModule,
+            .pName = "main",
+            .pSpecializationInfo = nullptr
+        },
+        .layout = pipeline_layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1
+    };
+    VkPipeline pipeline;
+    VkResult result = vkCreateComputePipelines(m_device, m_pipelineCache, 1, &pipelineCreateInfo, MLC_VULKAN_ALLOCATOR, &pipeline);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create compute pipeline.");
+    // Nothing was recorded with it, no need to go through the deletion queue
+    vkDestroyShaderModule(m_device, shaderModule, MLC_VULKAN_ALLOCATOR);
+
+    return pipeline;
+}
+
+void VulkanManager::_CreateHiZPipeline()
+{
+    // Late draws start after the early ones in the same run, so they need their own firstInstance
+    if (!m_drawIndirectFirstInstanceSupported || !m_depthSampled)
+    {
+        MLC_WARN("No drawIndirectFirstInstance or sampled depth, occlusion culling is disabled.");
+        return;
+    }
+
+    std::vector<char> bytecode;
+    File shaderFile("Engine/resources/shaders/bin/hiz_comp.spv");
+    if (!ReadShaderBytecode(shaderFile, bytecode))
+    {
+        MLC_WARN("\"{}\" isn't compiled, occlusion culling is disabled.", shaderFile.GetPath());
+        return;
+    }
+
+    std::array<VkDescriptorSetLayoutBinding, 3> layoutBindings {
+        VkDescriptorSetLayoutBinding {
+            .binding = 0,  // depth attachment
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr
+        },
+        VkDescriptorSetLayoutBinding {
+            .binding = 1,  // level below
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr
+        },
+        VkDescriptorSetLayoutBinding {
+            .binding = 2,  // level being built
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .pImmutableSamplers = nullptr
+        }
+    };
+    m_hiZDescriptorSetLayout = m_descriptorSetLayoutCache.GetLayout({ layoutBindings.begin(), layoutBindings.end() });
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes {
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = MAX_HIZ_LEVELS
+        },
+        VkDescriptorPoolSize {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 2 * MAX_HIZ_LEVELS
+        }
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .maxSets = MAX_HIZ_LEVELS,
+        .poolSizeCount = static_cast<uint32_t>(poolSizes.size()),
+        .pPoolSizes = poolSizes.data()
+    };
+    VkResult result = vkCreateDescriptorPool(m_device, &poolCreateInfo, MLC_VULKAN_ALLOCATOR, &m_hiZDescriptorPool);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create Hi-Z descriptor pool.");
+
+    VkPushConstantRange pushConstantRange {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(HiZParams)
+    };
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .flags = 0,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_hiZDescriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange
+    };
+    result = vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, MLC_VULKAN_ALLOCATOR, &m_hiZPipelineLayout);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create Hi-Z pipeline layout.");
+
+    m_hiZPipeline = _CreateComputePipeline(m_hiZPipelineLayout, bytecode);
+    m_occlusionCullingSupported = true;
+}
+
+void VulkanManager::_CreateHiZResources()
+{
+    // Level 0 matches the depth attachment texel for texel
+    m_hiZExtent = m_swapChainExtent;
+    uint32_t levelCount = 1;
+    while (levelCount < MAX_HIZ_LEVELS &&
+           std::max(m_hiZExtent.width, m_hiZExtent.height) >> levelCount > 0)
+    {
+        levelCount++;
+    }
+
+    AllocateImage2D(m_hiZImage,
+                    m_hiZExtent.width,
+                    m_hiZExtent.height,
+                    VK_FORMAT_R32_SFLOAT,
+                    VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    levelCount);
+    m_hiZView = _CreateImageView(m_hiZImage.m_handle, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount);
+    m_hiZLevelViews.resize(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        m_hiZLevelViews[level] = _CreateImageView(m_hiZImage.m_handle, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1);
+    }
+
+    // Stays in GENERAL, it's written as a storage image and sampled in between
+    VkCommandBuffer commandBuffer = _BeginSingleUseCommands(m_graphicsCmdPool);
+    VkImageMemoryBarrier imageBarrier {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = VK_NULL_HANDLE,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = m_hiZImage.m_handle,
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = levelCount,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    vkCmdPipelineBarrier(commandBuffer,
+                         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &imageBarrier);
+    _EndSingleUseCommands(commandBuffer, m_graphicsCmdPool);
+    m_hiZValid = false;
+
+    VkDescriptorImageInfo pyramidInfo {
+        .sampler = m_hiZSampler,
+        .imageView = m_hiZView,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+    };
+    for (VkDescriptorSet descriptorSet : m_cullDescriptorSets)
+    {
+        VkWriteDescriptorSet descriptorWrite {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = VK_NULL_HANDLE,
+            .dstSet = descriptorSet,
+            .dstBinding = 12,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &pyramidInfo,
+            .pBufferInfo = VK_NULL_HANDLE,
+            .pTexelBufferView = VK_NULL_HANDLE
+        };
+        vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+    }
+
+    if (!m_occlusionCullingSupported) return;
+
+    // A set per level, reading the depth attachment or the level below
+    vkResetDescriptorPool(m_device, m_hiZDescriptorPool, 0);
+    std::vector<VkDescriptorSetLayout> setLayouts(levelCount, m_hiZDescriptorSetLayout);
+    m_hiZDescriptorSets.resize(levelCount);
+    VkDescriptorSetAllocateInfo allocateInfo {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .descriptorPool = m_hiZDescriptorPool,
+        .descriptorSetCount = levelCount,
+        .pSetLayouts = setLayouts.data()
+    };
+    VkResult result = vkAllocateDescriptorSets(m_device, &allocateInfo, m_hiZDescriptorSets.data());
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to allocate Hi-Z descriptor sets.");
+
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        std::array<VkDescriptorImageInfo, 3> imageInfos {
+            VkDescriptorImageInfo {
+                .sampler = m_hiZSampler,
+                .imageView = m_depthImageView,
+                .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+            },
+            VkDescriptorImageInfo {
+                .sampler = VK_NULL_HANDLE,
+                .imageView = m_hiZLevelViews[level == 0 ? 0 : level - 1],  // level 0 doesn't read it
+                .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+            },
+            VkDescriptorImageInfo {
+                .sampler = VK_NULL_HANDLE,
+                .imageView = m_hiZLevelViews[level],
+                .imageLayout = VK_IMAGE_LAYOUT_GENERAL
+            }
+        };
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites;
+        for (uint32_t binding = 0; binding < descriptorWrites.size(); binding++)
+        {
+            descriptorWrites[binding] = VkWriteDescriptorSet {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = VK_NULL_HANDLE,
+                .dstSet = m_hiZDescriptorSets[level],
+                .dstBinding = binding,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+                                               : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo = &imageInfos[binding],
+                .pBufferInfo = VK_NULL_HANDLE,
+                .pTexelBufferView = VK_NULL_HANDLE
+            };
+        }
+        vkUpdateDescriptorSets(m_device,
+                               static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(),
+                               0,
+                               nullptr);
+    }
+}
+
+void VulkanManager::_DestroyHiZResources()
+{
+    // Only called with the device idle
+    for (VkImageView& levelView : m_hiZLevelViews)
+    {
+        vkDestroyImageView(m_device, levelView, MLC_VULKAN_ALLOCATOR);
+    }
+    m_hiZLevelViews.clear();
+    vkDestroyImageView(m_device, m_hiZView, MLC_VULKAN_ALLOCATOR);
+    m_hiZView = VK_NULL_HANDLE;
+    DeallocateImage2D(m_hiZImage);
+    m_hiZValid = false;
+}
+
+bool VulkanManager::_IsCullingActive() const
+{
+    return m_cullingSupported && m_hasCullingFrustum;
+}
+
+bool VulkanManager::_IsOcclusionCullingActive() const
+{
+    return _IsCullingActive() && m_occlusionCullingSupported;
+}
+
+void VulkanManager::_RecordCulling(VkCommandBuffer command_buffer, bool occlusion) const
+{
+    if (m_drawBatches.empty()) return;
+
+    const uint32_t batchCount = static_cast<uint32_t>(m_drawBatches.size());
+    const VkDeviceSize countsOffset = m_currentFrameIndex * AlignStorageOffset(sizeof(uint32_t) * MAX_DRAW_BATCHES_PER_FRAME);
+    vkCmdFillBuffer(command_buffer, m_drawCountBuffer.m_handle, countsOffset, sizeof(uint32_t) * batchCount, 0);
+    if (occlusion)
+    {
+        vkCmdFillBuffer(command_buffer,
+                        m_lateObjectBuffer.m_handle,
+                        m_currentFrameIndex * AlignStorageOffset(sizeof(uint32_t) * (1 + MAX_RING_INSTANCES_PER_FRAME)),
+                        sizeof(uint32_t),
+                        0);
+        vkCmdFillBuffer(command_buffer,
+                        m_lateInstanceCountBuffer.m_handle,
+                        m_currentFrameIndex * AlignStorageOffset(sizeof(uint32_t) * MAX_INDIRECT_COMMANDS_PER_FRAME),
+                        sizeof(uint32_t) * m_drawCommandCount,
+                        0);
+        vkCmdFillBuffer(command_buffer, m_lateDrawCountBuffer.m_handle, countsOffset, sizeof(uint32_t) * batchCount, 0);
+    }
+    // Also makes the pyramid a previous frame built visible
+    RecordMemoryBarrier(command_buffer,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+    vkCmdBindDescriptorSets(command_buffer,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_cullPipelineLayout,
+                            0,
+                            1,
+                            &m_cullDescriptorSets[m_currentFrameIndex],
+                            0,
+                            nullptr);
+
+    CullParams params {
+        .hiZSize = glm::vec2(static_cast<float>(m_hiZExtent.width), static_cast<float>(m_hiZExtent.height)),
+        .hiZLevels = static_cast<uint32_t>(m_hiZLevelViews.size()),
+        .objectCount = m_cullObjectCount,
+        .commandCount = m_drawCommandCount,
+        .pass = 0,
+        .occlusion = occlusion && m_hiZValid ? 1u : 0u
+    };
+
+    // Pass 0 counts every run's visible instances, pass 1 compacts the commands that still draw something
+    _DispatchCullPass(command_buffer, params, 0, m_cullObjectCount);
+    RecordMemoryBarrier(command_buffer,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    _DispatchCullPass(command_buffer, params, 1, m_drawCommandCount);
+    RecordMemoryBarrier(command_buffer,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void VulkanManager::_RecordLateCulling(VkCommandBuffer command_buffer) const
+{
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (_HasStencilComponent(_FindDepthFormat()))
+    {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    VkImageMemoryBarrier depthBarrier {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = VK_NULL_HANDLE,
+        .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = m_depthImage.m_handle,
+        .subresourceRange = VkImageSubresourceRange {
+            .aspectMask = depthAspect,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        }
+    };
+    // The early cull pass is done reading the old pyramid too
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &depthBarrier);
+
+    // ----- Hi-Z pyramid -----
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_hiZPipeline);
+    glm::ivec2 srcSize(static_cast<int>(m_hiZExtent.width), static_cast<int>(m_hiZExtent.height));
+    glm::ivec2 dstSize = srcSize;
+    for (uint32_t level = 0; level < m_hiZDescriptorSets.size(); level++)
+    {
+        if (level > 0)
+        {
+            srcSize = dstSize;
+            dstSize = glm::ivec2(std::max(srcSize.x / 2, 1), std::max(srcSize.y / 2, 1));
+        }
+        vkCmdBindDescriptorSets(command_buffer,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                m_hiZPipelineLayout,
+                                0,
+                                1,
+                                &m_hiZDescriptorSets[level],
+                                0,
+                                nullptr);
+        HiZParams params {
+            .srcSize = srcSize,
+            .dstSize = dstSize,
+            .fromDepth = level == 0 ? 1u : 0u
+        };
+        vkCmdPushConstants(command_buffer, m_hiZPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZParams), &params);
+        vkCmdDispatch(command_buffer,
+                      (dstSize.x + HIZ_WORKGROUP_SIZE - 1) / HIZ_WORKGROUP_SIZE,
+                      (dstSize.y + HIZ_WORKGROUP_SIZE - 1) / HIZ_WORKGROUP_SIZE,
+                      1);
+        RecordMemoryBarrier(command_buffer,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_ACCESS_SHADER_WRITE_BIT,
+                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            VK_ACCESS_SHADER_READ_BIT);
+    }
+    m_hiZValid = true;
+
+    // Back for the late render pass
+    std::swap(depthBarrier.oldLayout, depthBarrier.newLayout);
+    depthBarrier.srcAccessMask = 0;
+    depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    vkCmdPipelineBarrier(command_buffer,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                         0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &depthBarrier);
+
+    if (m_drawBatches.empty()) return;
+
+    // ----- Late culling -----
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+    vkCmdBindDescriptorSets(command_buffer,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            m_cullPipelineLayout,
+                            0,
+                            1,
+                            &m_cullDescriptorSets[m_currentFrameIndex],
+                            0,
+                            nullptr);
+
+    CullParams params {
+        .hiZSize = glm::vec2(static_cast<float>(m_hiZExtent.width), static_cast<float>(m_hiZExtent.height)),
+        .hiZLevels = static_cast<uint32_t>(m_hiZLevelViews.size()),
+        .objectCount = m_cullObjectCount,
+        .commandCount = m_drawCommandCount,
+        .pass = 2,
+        .occlusion = 1
+    };
+
+    // The late list's length is only known on the GPU, every cull object gets a thread
+    _DispatchCullPass(command_buffer, params, 2, m_cullObjectCount);
+    RecordMemoryBarrier(command_buffer,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    _DispatchCullPass(command_buffer, params, 3, m_drawCommandCount);
+    RecordMemoryBarrier(command_buffer,
+                        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                        VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void VulkanManager::_DispatchCullPass(VkCommandBuffer command_buffer,
+                                      CullParams& params,
+                                      uint32_t pass,
+                                      uint32_t thread_count) const
+{
+    params.pass = pass;
+    vkCmdPushConstants(command_buffer, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), &params);
+    if (thread_count > 0)
+    {
+        vkCmdDispatch(command_buffer, (thread_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+    }
+}
+
+void VulkanManager::_CreateUploadTimeline()
+{
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0
+    };
+    VkSemaphoreCreateInfo semaphoreCreateInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &semaphoreTypeCreateInfo,
+        .flags = 0
+    };
+
+    VkResult result = vkCreateSemaphore(m_device, &semaphoreCreateInfo, MLC_VULKAN_ALLOCATOR, &m_uploadTimeline);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to create upload timeline semaphore.");
+    m_uploadTimelineValue = 0;
+}
+
+void VulkanManager::_RecordCopyBufferToImage(VkCommandBuffer command_buffer,
+                                             VkBuffer src,
+                                             VkDeviceSize src_offset,
+                                             VkImage dst,
+                                             uint32_t width,
+                                             uint32_t height) const
+{
+    VkBufferImageCopy region {
+        .bufferOffset = src_offset,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = VkImageSubresourceLayers {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .mipLevel = 0,
+            .baseArrayLayer = 0,
+            .layerCount = 1
+        },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = VkExtent3D {
+            .width = width,
+            .height = height,
+            .depth = 1
+        }
+    };
+    vkCmdCopyBufferToImage(command_buffer,
+                           src,
+                           dst,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1,
+                           &region);
 }
 
 void VulkanManager::_RecreateSwapChain()
@@ -1778,15 +4557,31 @@ void VulkanManager::_RecreateSwapChain()
     DeallocateImage2D(m_depthImage);
     vkDestroyImageView(m_device, m_depthImageView, MLC_VULKAN_ALLOCATOR);
 
+    if (m_cullingSupported)
+    {
+        _DestroyHiZResources();
+    }
+    _DestroyRetainedCommands();
+
     _CreateSwapChain();
     _CreateSwapChainImageViews();
     _CreateDepthResources();
-    _CreateFramebuffers();
+    if (!m_dynamicRendering)
+    {
+        _CreateFramebuffers();
+    }
+    if (m_cullingSupported)
+    {
+        _CreateHiZResources();
+    }
+    _CreateRetainedCommands();
 }
 
 VkImageView VulkanManager::_CreateImageView(const VkImage& image,
                                             VkFormat format,
-                                            VkImageAspectFlags aspectFlags) const
+                                            VkImageAspectFlags aspectFlags,
+                                            uint32_t base_mip_level,
+                                            uint32_t mip_level_count) const
 {
     VkImageViewCreateInfo createInfo {
         .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -1803,8 +4598,8 @@ VkImageView VulkanManager::_CreateImageView(const VkImage& image,
         },
         .subresourceRange = {
             .aspectMask = aspectFlags,
-            .baseMipLevel = 0,
-            .levelCount = 1,
+            .baseMipLevel = base_mip_level,
+            .levelCount = mip_level_count,
             .baseArrayLayer = 0,
             .layerCount = 1
         }
@@ -1817,21 +4612,118 @@ VkImageView VulkanManager::_CreateImageView(const VkImage& image,
     return imageView;
 }
 
-uint32_t VulkanManager::_FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const
+VulkanManager::StagingAllocation VulkanManager::_AllocateStaging(UploadBatch& batch, VkDeviceSize size) const
+{
+    _ReclaimUploads();
+
+    // Ring memory isn't retired while a batch is open, or an unrelated submission
+    // could hand the batch's staging back before the batch reads it
+    if (!batch.m_holdsStaging)
+    {
+        m_openUploadBatches++;
+        batch.m_holdsStaging = true;
+    }
+
+    uint64_t offset = m_stagingRing.Allocate(size, STAGING_BUFFER_ALIGNMENT);
+    // Ring is full of in-flight uploads, wait for the oldest ones
+    while (offset == RingAllocator::INVALID_OFFSET &&
+           size <= m_stagingRing.GetSize() &&
+           m_stagingRing.HasRetired())
+    {
+        WaitUpload(UploadTicket { .value = m_stagingRing.GetOldestRetiredSerial() });
+        offset = m_stagingRing.Allocate(size, STAGING_BUFFER_ALIGNMENT);
+    }
+    if (offset != RingAllocator::INVALID_OFFSET)
+    {
+        return StagingAllocation {
+            .buffer = m_stagingBuffer.m_handle,
+            .offset = offset,
+            .mappedData = static_cast<char*>(m_stagingBuffer.m_allocation.mappedData) + offset
+        };
+    }
+
+    // Doesn't fit, give this upload its own buffer. It's freed once the batch completes.
+    GPUBuffer& buffer = batch.m_overflowBuffers.emplace_back();
+    AllocateBuffer(buffer,
+                   size,
+                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    return StagingAllocation {
+        .buffer = buffer.m_handle,
+        .offset = 0,
+        .mappedData = buffer.m_allocation.mappedData
+    };
+}
+
+void VulkanManager::_ReclaimUploads() const
 {
-    VkPhysicalDeviceMemoryProperties memoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memoryProperties);
+    uint64_t completedValue;
+    vkGetSemaphoreCounterValue(m_device, m_uploadTimeline, &completedValue);
+
+    m_stagingRing.Reclaim(completedValue);
 
-    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+    for (auto it = m_stagingOverflowBuffers.begin(); it != m_stagingOverflowBuffers.end();)
     {
-        if ((type_filter & (1 << i)) &&
-            (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        if (it->first <= completedValue)
         {
-            return i;
+            DeallocateBuffer(it->second);
+            it = m_stagingOverflowBuffers.erase(it);
         }
+        else
+        {
+            it++;
+        }
+    }
+
+    // Submitted in order, so they complete in order
+    size_t completedCount = 0;
+    while (completedCount < m_pendingUploadCmdBuffers.size() &&
+           m_pendingUploadCmdBuffers[completedCount].first <= completedValue)
+    {
+        vkFreeCommandBuffers(m_device, m_transferCmdPool, 1, &m_pendingUploadCmdBuffers[completedCount].second);
+        completedCount++;
+    }
+    m_pendingUploadCmdBuffers.erase(m_pendingUploadCmdBuffers.begin(),
+                                    m_pendingUploadCmdBuffers.begin() + completedCount);
+}
+
+UploadTicket VulkanManager::_SubmitUpload(VkCommandBuffer command_buffer) const
+{
+    vkEndCommandBuffer(command_buffer);
+
+    // Staging memory written so far is read by this submission, or by a batch
+    // that's still being filled (in which case it's retired when that's submitted)
+    m_uploadTimelineValue++;
+    if (m_openUploadBatches == 0)
+    {
+        m_stagingRing.Retire(m_uploadTimelineValue);
     }
-    MLC_ASSERT(false, "Failed to find suitable device memory type.");
-    return static_cast<uint32_t>(-1);
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = VK_NULL_HANDLE,
+        .waitSemaphoreValueCount = 0,
+        .pWaitSemaphoreValues = nullptr,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &m_uploadTimelineValue
+    };
+    VkSubmitInfo submitInfo {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timelineSubmitInfo,
+        .waitSemaphoreCount = 0,
+        .pWaitSemaphores = nullptr,
+        .pWaitDstStageMask = nullptr,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &m_uploadTimeline
+    };
+
+    VkResult result = vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE);
+    MLC_ASSERT(result == VK_SUCCESS, "Failed to submit upload command buffer.");
+
+    m_pendingUploadCmdBuffers.emplace_back(m_uploadTimelineValue, command_buffer);
+    return UploadTicket { .value = m_uploadTimelineValue };
 }
 
 VkCommandBuffer VulkanManager::_BeginSingleUseCommands(const VkCommandPool& command_pool) const
@@ -1861,6 +4753,14 @@ VkCommandBuffer VulkanManager::_BeginSingleUseCommands(const VkCommandPool& comm
 
 void VulkanManager::_EndSingleUseCommands(VkCommandBuffer& command_buffer, const VkCommandPool& command_pool) const
 {
+    // Transfer submissions have to go through the upload timeline to keep its values in order
+    if (command_pool == m_transferCmdPool)
+    {
+        WaitUpload(_SubmitUpload(command_buffer));
+        command_buffer = VK_NULL_HANDLE;
+        return;
+    }
+
     vkEndCommandBuffer(command_buffer);
 
     VkSubmitInfo submitInfo {
@@ -1877,12 +4777,9 @@ void VulkanManager::_EndSingleUseCommands(VkCommandBuffer& command_buffer, const
     VkFence fence;
     CreateFences(&fence, 1, false);
 
-    VkQueue queue;
-    if (command_pool == m_graphicsCmdPool) queue = m_graphicsQueue;
-    else if (command_pool == m_transferCmdPool) queue = m_transferQueue;
-    else MLC_ASSERT(false, "Unknown command pool.");
+    MLC_ASSERT(command_pool == m_graphicsCmdPool, "Unknown command pool.");
 
-    vkQueueSubmit(queue, 1, &submitInfo, fence);
+    vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, fence);
     vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX);
     vkFreeCommandBuffers(m_device, command_pool, 1, &command_buffer);
 
@@ -0,0 +1,88 @@
+// Times FrustumCuller::Cull over 100k spheres scattered around a camera frustum.
+// Built with -DMLC_BUILD_BENCHMARKS=ON, add -mavx to the compile options for the AVX path.
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Engine/core/FrustumCuller.h"
+
+static constexpr uint32_t OBJECT_COUNT = 100000;
+static constexpr uint32_t WARMUP_RUNS = 100;
+static constexpr uint32_t RUNS = 2000;
+
+int main()
+{
+    // Same plane extraction as VulkanManager::SetCullingFrustum
+    glm::mat4 clipFromWorld = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f) *
+                              glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    auto row = [&clipFromWorld](int i) {
+        return glm::vec4(clipFromWorld[0][i], clipFromWorld[1][i], clipFromWorld[2][i], clipFromWorld[3][i]);
+    };
+    std::array<glm::vec4, 6> planes {
+        row(3) + row(0),
+        row(3) - row(0),
+        row(3) + row(1),
+        row(3) - row(1),
+        row(2),
+        row(3) - row(2)
+    };
+    for (glm::vec4& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    // Fixed seed, every run culls the same scene
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 5.0f);
+    Malic::FrustumCuller culler;
+    culler.Reserve(OBJECT_COUNT);
+    for (uint32_t i = 0; i < OBJECT_COUNT; i++)
+    {
+        culler.Add(glm::vec4(position(random), position(random), position(random), radius(random)));
+    }
+
+    std::vector<uint8_t> visibility;
+    for (uint32_t run = 0; run < WARMUP_RUNS; run++)
+    {
+        culler.Cull(planes, visibility);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t run = 0; run < RUNS; run++)
+    {
+        culler.Cull(planes, visibility);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    uint32_t visible = 0;
+    for (uint8_t v : visibility)
+    {
+        visible += v;
+    }
+    double microseconds = std::chrono::duration<double, std::micro>(end - start).count() / RUNS;
+#if defined(__AVX__)
+    const char* path = "AVX";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    const char* path = "SSE";
+#else
+    const char* path = "scalar";
+#endif
+    std::printf("%s: %u objects, %u visible, %.1f us per cull, %.0f objects/us\n",
+                path,
+                OBJECT_COUNT,
+                visible,
+                microseconds,
+                OBJECT_COUNT / microseconds);
+
+    return 0;
+}
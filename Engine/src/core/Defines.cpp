@@ -1,7 +1,9 @@
 #include "Engine/core/Defines.h"
 
+#include "Engine/VulkanHostAllocator.h"
+
 MLC_NAMESPACE_START
 
-const VkAllocationCallbacks* MLC_VULKAN_ALLOCATOR = nullptr;
+const VkAllocationCallbacks* MLC_VULKAN_ALLOCATOR = VulkanHostAllocator::Get().GetCallbacks();
 
 MLC_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "Engine/core/DeletionQueue.h"
+
+#include "Engine/core/Assert.h"
+
+MLC_NAMESPACE_START
+
+void DeletionQueue::Push(uint64_t serial, std::function<void()> deleter)
+{
+    MLC_ASSERT(m_deletions.empty() || m_deletions.back().serial <= serial,
+               "Deletions have to be pushed in serial order.");
+    m_deletions.push_back(Deletion {
+        .serial = serial,
+        .deleter = std::move(deleter)
+    });
+}
+
+void DeletionQueue::Flush(uint64_t completed_serial)
+{
+    while (!m_deletions.empty() && m_deletions.front().serial <= completed_serial)
+    {
+        // Popped first, a deleter is allowed to push more deletions
+        std::function<void()> deleter = std::move(m_deletions.front().deleter);
+        m_deletions.pop_front();
+        deleter();
+    }
+}
+
+void DeletionQueue::FlushAll()
+{
+    while (!m_deletions.empty())
+    {
+        std::function<void()> deleter = std::move(m_deletions.front().deleter);
+        m_deletions.pop_front();
+        deleter();
+    }
+}
+
+bool DeletionQueue::IsEmpty() const
+{
+    return m_deletions.empty();
+}
+
+MLC_NAMESPACE_END
@@ -4,6 +4,11 @@
 
 #include <fmt/format.h>
 
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#endif
+
 #include "Engine/core/Assert.h"
 
 MLC_NAMESPACE_START
@@ -25,4 +30,26 @@ const char* File::GetPath() const
     return m_path.c_str();
 }
 
+std::filesystem::path GetExecutableDirectory()
+{
+#ifdef _WIN32
+    std::wstring path(MAX_PATH, L'\0');
+    DWORD length = GetModuleFileNameW(nullptr, path.data(), static_cast<DWORD>(path.size()));
+    if (length == 0 || length == path.size())
+    {
+        return std::filesystem::current_path();
+    }
+    path.resize(length);
+    return std::filesystem::path(path).parent_path();
+#else
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::read_symlink("/proc/self/exe", error);
+    if (error)
+    {
+        return std::filesystem::current_path();
+    }
+    return path.parent_path();
+#endif
+}
+
 MLC_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "Engine/core/FreeListAllocator.h"
+
+#include "Engine/core/Assert.h"
+
+MLC_NAMESPACE_START
+
+FreeListAllocator::FreeListAllocator(uint64_t size)
+    : m_size(size)
+{
+    Reset();
+}
+
+uint64_t FreeListAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    MLC_ASSERT(size > 0, "Can't allocate an empty range.");
+    MLC_ASSERT(alignment > 0, "Alignment must be greater than 0.");
+
+    // First fit, the ranges are kept coalesced so this stays short
+    for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); it++)
+    {
+        uint64_t rangeOffset = it->first;
+        uint64_t rangeSize = it->second;
+        uint64_t alignedOffset = (rangeOffset + alignment - 1) / alignment * alignment;
+        uint64_t padding = alignedOffset - rangeOffset;
+
+        if (padding + size > rangeSize) continue;
+
+        m_freeRanges.erase(it);
+        if (padding > 0)
+        {
+            m_freeRanges[rangeOffset] = padding;
+        }
+        if (padding + size < rangeSize)
+        {
+            m_freeRanges[alignedOffset + size] = rangeSize - padding - size;
+        }
+
+        m_usedSize += size;
+        return alignedOffset;
+    }
+
+    return INVALID_OFFSET;
+}
+
+void FreeListAllocator::Free(uint64_t offset, uint64_t size)
+{
+    MLC_ASSERT(offset + size <= m_size, "Freed range is out of bounds.");
+    MLC_ASSERT(!m_freeRanges.contains(offset), "Range was already freed.");
+
+    auto [it, inserted] = m_freeRanges.emplace(offset, size);
+    m_usedSize -= size;
+
+    // Merge with the next range
+    auto next = std::next(it);
+    if (next != m_freeRanges.end() && it->first + it->second == next->first)
+    {
+        it->second += next->second;
+        m_freeRanges.erase(next);
+    }
+
+    // Merge with the previous range
+    if (it != m_freeRanges.begin())
+    {
+        auto prev = std::prev(it);
+        if (prev->first + prev->second == it->first)
+        {
+            prev->second += it->second;
+            m_freeRanges.erase(it);
+        }
+    }
+}
+
+void FreeListAllocator::Reset()
+{
+    m_freeRanges.clear();
+    m_usedSize = 0;
+    if (m_size > 0)
+    {
+        m_freeRanges[0] = m_size;
+    }
+}
+
+uint64_t FreeListAllocator::GetSize() const
+{
+    return m_size;
+}
+
+uint64_t FreeListAllocator::GetUsedSize() const
+{
+    return m_usedSize;
+}
+
+bool FreeListAllocator::IsEmpty() const
+{
+    return m_usedSize == 0;
+}
+
+MLC_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "Engine/core/FrustumCuller.h"
+
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define MLC_FRUSTUM_CULLER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define MLC_FRUSTUM_CULLER_SSE
+#endif
+
+MLC_NAMESPACE_START
+
+// A 4 bit lane mask spread out to a 0 or 1 byte per lane (little endian)
+static constexpr std::array<uint32_t, 16> MASK_TO_BYTES = [] {
+    std::array<uint32_t, 16> bytes {};
+    for (uint32_t mask = 0; mask < 16; mask++)
+    {
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            bytes[mask] |= ((mask >> lane) & 1) << (lane * 8);
+        }
+    }
+    return bytes;
+}();
+
+void FrustumCuller::Clear()
+{
+    m_centerX.clear();
+    m_centerY.clear();
+    m_centerZ.clear();
+    m_radius.clear();
+}
+
+void FrustumCuller::Reserve(uint32_t count)
+{
+    m_centerX.reserve(count);
+    m_centerY.reserve(count);
+    m_centerZ.reserve(count);
+    m_radius.reserve(count);
+}
+
+void FrustumCuller::Add(const glm::vec4& sphere)
+{
+    m_centerX.push_back(sphere.x);
+    m_centerY.push_back(sphere.y);
+    m_centerZ.push_back(sphere.z);
+    // Infinity passes every plane, no special case in the loop
+    m_radius.push_back(sphere.w > 0.0f ? sphere.w : std::numeric_limits<float>::infinity());
+}
+
+uint32_t FrustumCuller::GetCount() const
+{
+    return static_cast<uint32_t>(m_radius.size());
+}
+
+void FrustumCuller::Cull(const std::array<glm::vec4, 6>& planes, std::vector<uint8_t>& visibility) const
+{
+    const uint32_t count = GetCount();
+    visibility.resize(count);
+
+    uint32_t i = 0;
+#if defined(MLC_FRUSTUM_CULLER_AVX)
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (uint32_t plane = 0; plane < planes.size(); plane++)
+    {
+        planeX[plane] = _mm256_set1_ps(planes[plane].x);
+        planeY[plane] = _mm256_set1_ps(planes[plane].y);
+        planeZ[plane] = _mm256_set1_ps(planes[plane].z);
+        planeW[plane] = _mm256_set1_ps(planes[plane].w);
+    }
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(&m_centerX[i]);
+        __m256 y = _mm256_loadu_ps(&m_centerY[i]);
+        __m256 z = _mm256_loadu_ps(&m_centerZ[i]);
+        __m256 r = _mm256_loadu_ps(&m_radius[i]);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (uint32_t plane = 0; plane < planes.size(); plane++)
+        {
+            // dot(normal, center) + distance + radius >= 0
+            __m256 d = _mm256_add_ps(_mm256_mul_ps(x, planeX[plane]), planeW[plane]);
+            d = _mm256_add_ps(d, _mm256_mul_ps(y, planeY[plane]));
+            d = _mm256_add_ps(d, _mm256_mul_ps(z, planeZ[plane]));
+            d = _mm256_add_ps(d, r);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+        uint64_t bytes = static_cast<uint64_t>(MASK_TO_BYTES[mask & 0xF]) |
+                         static_cast<uint64_t>(MASK_TO_BYTES[mask >> 4]) << 32;
+        memcpy(&visibility[i], &bytes, sizeof(bytes));
+    }
+#elif defined(MLC_FRUSTUM_CULLER_SSE)
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (uint32_t plane = 0; plane < planes.size(); plane++)
+    {
+        planeX[plane] = _mm_set1_ps(planes[plane].x);
+        planeY[plane] = _mm_set1_ps(planes[plane].y);
+        planeZ[plane] = _mm_set1_ps(planes[plane].z);
+        planeW[plane] = _mm_set1_ps(planes[plane].w);
+    }
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&m_centerX[i]);
+        __m128 y = _mm_loadu_ps(&m_centerY[i]);
+        __m128 z = _mm_loadu_ps(&m_centerZ[i]);
+        __m128 r = _mm_loadu_ps(&m_radius[i]);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (uint32_t plane = 0; plane < planes.size(); plane++)
+        {
+            // dot(normal, center) + distance + radius >= 0
+            __m128 d = _mm_add_ps(_mm_mul_ps(x, planeX[plane]), planeW[plane]);
+            d = _mm_add_ps(d, _mm_mul_ps(y, planeY[plane]));
+            d = _mm_add_ps(d, _mm_mul_ps(z, planeZ[plane]));
+            d = _mm_add_ps(d, r);
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+        }
+        uint32_t bytes = MASK_TO_BYTES[_mm_movemask_ps(inside)];
+        memcpy(&visibility[i], &bytes, sizeof(bytes));
+    }
+#endif
+
+    // Whatever doesn't fill a full register
+    for (; i < count; i++)
+    {
+        bool inside = true;
+        for (const glm::vec4& plane : planes)
+        {
+            float d = m_centerX[i] * plane.x + m_centerY[i] * plane.y + m_centerZ[i] * plane.z + plane.w + m_radius[i];
+            inside &= d >= 0.0f;
+        }
+        visibility[i] = inside ? 1 : 0;
+    }
+}
+
+MLC_NAMESPACE_END
@@ -0,0 +1,29 @@
+#include "Engine/core/Hash.h"
+
+#include <cstring>
+
+MLC_NAMESPACE_START
+
+void HashCombine(uint64_t& hash, uint64_t value)
+{
+    hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+}
+
+void HashBytes(uint64_t& hash, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(uint64_t));
+        HashCombine(hash, word);
+    }
+    if (size > 0)
+    {
+        uint64_t word = 0;
+        memcpy(&word, bytes, size);
+        HashCombine(hash, word);
+    }
+}
+
+MLC_NAMESPACE_END
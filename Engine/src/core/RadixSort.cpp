@@ -0,0 +1,54 @@
+#include "Engine/core/RadixSort.h"
+
+#include <array>
+
+MLC_NAMESPACE_START
+
+void RadixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+{
+    constexpr uint32_t PASS_COUNT = sizeof(uint64_t);
+    constexpr uint32_t BUCKET_COUNT = 256;
+
+    if (items.size() < 2) return;
+    scratch.resize(items.size());
+
+    // Every pass's histogram in one read of the keys
+    std::array<std::array<uint32_t, BUCKET_COUNT>, PASS_COUNT> histograms {};
+    for (const SortItem& item : items)
+    {
+        for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+        {
+            histograms[pass][(item.key >> (pass * 8)) & 0xFF]++;
+        }
+    }
+
+    std::vector<SortItem>* src = &items;
+    std::vector<SortItem>* dst = &scratch;
+    for (uint32_t pass = 0; pass < PASS_COUNT; pass++)
+    {
+        std::array<uint32_t, BUCKET_COUNT>& histogram = histograms[pass];
+        uint32_t firstByte = ((*src)[0].key >> (pass * 8)) & 0xFF;
+        if (histogram[firstByte] == items.size()) continue;
+
+        uint32_t offset = 0;
+        for (uint32_t& count : histogram)
+        {
+            uint32_t bucketSize = count;
+            count = offset;
+            offset += bucketSize;
+        }
+
+        for (const SortItem& item : *src)
+        {
+            (*dst)[histogram[(item.key >> (pass * 8)) & 0xFF]++] = item;
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != &items)
+    {
+        items.swap(scratch);
+    }
+}
+
+MLC_NAMESPACE_END
@@ -0,0 +1,107 @@
+#include "Engine/core/RingAllocator.h"
+
+#include "Engine/core/Assert.h"
+
+MLC_NAMESPACE_START
+
+RingAllocator::RingAllocator(uint64_t size)
+    : m_size(size)
+{}
+
+uint64_t RingAllocator::Allocate(uint64_t size, uint64_t alignment)
+{
+    MLC_ASSERT(size > 0, "Can't allocate an empty range.");
+    MLC_ASSERT(alignment > 0, "Alignment must be greater than 0.");
+
+    if (size > m_size || m_usedSize == m_size) return INVALID_OFFSET;
+
+    uint64_t alignedHead = (m_head + alignment - 1) / alignment * alignment;
+    uint64_t offset;
+    if (m_head >= m_tail)
+    {
+        // Free space is [head, size) followed by [0, tail)
+        if (alignedHead + size <= m_size)
+        {
+            offset = alignedHead;
+        }
+        else if (size <= m_tail)
+        {
+            // Wrap around, the end of the ring is wasted until it's reclaimed
+            m_usedSize += m_size - m_head;
+            m_unretiredSize += m_size - m_head;
+            m_head = 0;
+            offset = 0;
+        }
+        else
+        {
+            return INVALID_OFFSET;
+        }
+    }
+    else
+    {
+        // Free space is [head, tail)
+        if (alignedHead + size > m_tail) return INVALID_OFFSET;
+        offset = alignedHead;
+    }
+
+    uint64_t allocatedSize = offset + size - m_head;
+    m_usedSize += allocatedSize;
+    m_unretiredSize += allocatedSize;
+    m_head = offset + size;
+
+    return offset;
+}
+
+void RingAllocator::Retire(uint64_t serial)
+{
+    if (m_unretiredSize == 0) return;
+
+    MLC_ASSERT(m_retiredRanges.empty() || m_retiredRanges.back().serial <= serial,
+               "Ring ranges have to be retired in submission order.");
+    m_retiredRanges.push_back(RetiredRange {
+        .end = m_head,
+        .size = m_unretiredSize,
+        .serial = serial
+    });
+    m_unretiredSize = 0;
+}
+
+void RingAllocator::Reclaim(uint64_t completed_serial)
+{
+    while (!m_retiredRanges.empty() && m_retiredRanges.front().serial <= completed_serial)
+    {
+        m_tail = m_retiredRanges.front().end;
+        m_usedSize -= m_retiredRanges.front().size;
+        m_retiredRanges.pop_front();
+    }
+
+    // Start from the beginning again so big allocations don't have to wrap
+    if (m_usedSize == 0)
+    {
+        m_head = 0;
+        m_tail = 0;
+    }
+}
+
+bool RingAllocator::HasRetired() const
+{
+    return !m_retiredRanges.empty();
+}
+
+uint64_t RingAllocator::GetOldestRetiredSerial() const
+{
+    MLC_ASSERT(!m_retiredRanges.empty(), "No retired ranges.");
+    return m_retiredRanges.front().serial;
+}
+
+uint64_t RingAllocator::GetSize() const
+{
+    return m_size;
+}
+
+uint64_t RingAllocator::GetUsedSize() const
+{
+    return m_usedSize;
+}
+
+MLC_NAMESPACE_END
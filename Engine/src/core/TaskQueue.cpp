@@ -0,0 +1,85 @@
+#include "Engine/core/TaskQueue.h"
+
+#include "Engine/core/Assert.h"
+
+MLC_NAMESPACE_START
+
+TaskQueue::~TaskQueue()
+{
+    Stop();
+}
+
+void TaskQueue::Start(uint32_t worker_count)
+{
+    MLC_ASSERT(m_workers.empty(), "TaskQueue was already started.");
+
+    m_stopping = false;
+    m_workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; i++)
+    {
+        m_workers.emplace_back(&TaskQueue::_WorkerLoop, this);
+    }
+}
+
+void TaskQueue::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_tasks.clear();
+    }
+    m_taskAvailable.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+    m_idle.notify_all();
+}
+
+void TaskQueue::Push(std::function<void()> task)
+{
+    if (m_workers.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_taskAvailable.notify_one();
+}
+
+void TaskQueue::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_tasks.empty() && m_runningTasks == 0; });
+}
+
+void TaskQueue::_WorkerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskAvailable.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping) return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            m_runningTasks++;
+        }
+
+        task();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_runningTasks == 0 && m_tasks.empty())
+        {
+            m_idle.notify_all();
+        }
+    }
+}
+
+MLC_NAMESPACE_END
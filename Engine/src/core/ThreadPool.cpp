@@ -0,0 +1,105 @@
+#include "Engine/core/ThreadPool.h"
+
+#include "Engine/core/Assert.h"
+
+MLC_NAMESPACE_START
+
+ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+void ThreadPool::Start(uint32_t worker_count)
+{
+    MLC_ASSERT(m_workers.empty(), "ThreadPool was already started.");
+
+    m_stopping = false;
+    m_workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::_WorkerLoop, this);
+    }
+}
+
+void ThreadPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+uint32_t ThreadPool::GetThreadCount() const
+{
+    return static_cast<uint32_t>(m_workers.size()) + 1;
+}
+
+void ThreadPool::Run(uint32_t job_count, const std::function<void(uint32_t job_index)>& job)
+{
+    // Not worth waking anyone up for
+    if (m_workers.empty() || job_count <= 1)
+    {
+        for (uint32_t i = 0; i < job_count; i++)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_jobCount = job_count;
+        m_nextJob = 0;
+        m_busyWorkers = static_cast<uint32_t>(m_workers.size());
+        m_generation++;
+    }
+    m_workAvailable.notify_all();
+
+    _ProcessJobs();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_workDone.wait(lock, [this]() { return m_busyWorkers == 0; });
+    m_job = nullptr;
+}
+
+void ThreadPool::_WorkerLoop()
+{
+    uint64_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [this, seenGeneration]() {
+                return m_stopping || m_generation != seenGeneration;
+            });
+            if (m_stopping) return;
+            seenGeneration = m_generation;
+        }
+
+        _ProcessJobs();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busyWorkers == 0)
+        {
+            m_workDone.notify_one();
+        }
+    }
+}
+
+void ThreadPool::_ProcessJobs()
+{
+    // m_job and m_jobCount were set under the mutex before the generation changed
+    for (uint32_t jobIndex = m_nextJob++; jobIndex < m_jobCount; jobIndex = m_nextJob++)
+    {
+        (*m_job)(jobIndex);
+    }
+}
+
+MLC_NAMESPACE_END